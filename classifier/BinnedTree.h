@@ -0,0 +1,90 @@
+/** @file  BinnedTree.h
+    @brief declaration of class BinnedTree
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_BinnedTree_h
+#define classifier_BinnedTree_h
+
+#include "classifier/CompiledTree.h"
+#include <vector>
+
+/** @class BinnedTree
+@brief Evaluate an ensemble with integer compares, after binning each variable once per event.
+
+The cuts in all the trees on a variable form a finite set. Each event value is replaced by its
+bin: the number of those cuts that are less than or equal to it, found by a binary search.
+A test value < cut, where the cut is the j'th (from 0) in the sorted set, is then the same as
+bin < j+1, so the trees need only small integers. A NaN value is put in the last bin, and so
+fails every test, as in the tree walk.
+
+The nodes are 8 bytes, half the size of a CompiledTree node, with the leaf values in a separate
+array, so that more of the ensemble fits in cache. The binning is done once per event for all
+the trees. The result is identical to DecisionTree::operator().
+
+At most 65535 distinct cuts per variable are allowed.
+*/
+class BinnedTree {
+public:
+    typedef unsigned short Bin;
+
+    /// a node: a leaf has feature s_leaf, and child is the position of its value
+    struct Node {
+        Bin feature;         ///< index of the variable to test
+        Bin cut;             ///< go left if the bin is less than this
+        unsigned int child;  ///< for a branch, position of the left child relative to the tree start
+    };
+    static const Bin s_leaf = 0xffff;
+
+    /// set up from a compiled model
+    explicit BinnedTree(const CompiledTree& model);
+
+    /// evaluate one event: no allocation, unless the width is more than 255
+    double operator()(const float* row)const;
+    double operator()(const std::vector<float>& row)const{return (*this)(&row[0]);}
+
+    /** @brief evaluate a block of events
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param scores output array of count values
+
+        Events are binned CompiledTree::s_block at a time, then passed through each tree in turn.
+    */
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const;
+
+    /// find the bins of the variables used, for one event. bins must have width() entries
+    void bin(const float* row, Bin* bins)const;
+
+    /// evaluate one tree, given the bins
+    double evaluate(unsigned int tree, const Bin* bins)const
+    {
+        const Node* root = &m_nodes[m_offsets[tree]];
+        const Node* node = root;
+        while( node->feature != s_leaf ){
+            node = root + node->child + (bins[node->feature] < node->cut ? 0 : 1);
+        }
+        return m_leaves[node->child];
+    }
+
+    /// number of variables: one more than the largest index used
+    int width()const{return m_cuts.size();}
+    /// number of distinct cuts on variable i
+    size_t cuts(int i)const{return m_cuts[i].size();}
+    /// total number of nodes
+    size_t size()const{return m_nodes.size();}
+
+private:
+    /// the weighted average, given the bins
+    double score(const Bin* bins)const;
+
+    std::vector<std::vector<double> > m_cuts; ///< for each variable, the sorted distinct cuts
+    std::vector<int> m_used;               ///< the variables with any cuts
+    std::vector<Node> m_nodes;
+    std::vector<double> m_leaves;          ///< leaf values
+    std::vector<unsigned int> m_offsets;   ///< root node of each tree
+    std::vector<double> m_weights;         ///< weight of each tree, not positive for a filter
+};
+
+#endif
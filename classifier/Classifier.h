@@ -21,6 +21,9 @@
     - SplitCriterion abstract base class for splitting
     - Visitor abstract base class allowing visitors to traverse the tree (Visitor Pattern)
 
+With Record::setClasses, the records are also labeled by class, and training uses the Gini
+impurity for all the classes. Each leaf of the tree made by createTree then has the purity of
+each class as its outputs, see DecisionTree::addLeaf, besides the signal purity.
 */
 class Classifier {
 public:
@@ -66,6 +69,16 @@ public:
         void reweight(double factor){ m_sigwt*= factor; m_bkgwt*=factor;}
         bool signal()const{return m_sigwt>0;}
 
+        /// the class, for training with several: by default 1 for signal, 0 for background
+        int category()const{return m_category;}
+        void setCategory(int category);
+
+        /** @brief set the number of classes for training with several, each record labeled by setCategory
+            @param classes 0, the default, for signal and background only
+        */
+        static void setClasses(int classes){s_classes=classes;}
+        static int classes(){return s_classes;}
+
         /// set the cumulative weigths, part of sorting
         void setCumWeights(double sig, double bkg){m_cumsig=sig, m_cumbkg=bkg;}
         /** set static variables 
@@ -88,10 +101,12 @@ public:
         float m_bkgwt;
         float m_cumsig;
         float m_cumbkg;
+        int m_category;
     private:
         static std::vector<std::string> s_column_names;
         static bool s_use_weights;
         static int s_size;
+        static int s_classes;
     };
     //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
         /** @class Table is a vector of Records
@@ -205,6 +220,8 @@ public:
         Identifier_t id() const {return m_id;}
 
         double purity()const { return m_signal/(m_signal + m_background);}
+        /// with several classes, see Record::setClasses, the fraction of the weight in each
+        std::vector<double> purities()const;
         double value()const { return m_split_value;}
         bool isLeaf()const { return m_left==0;}
 
@@ -226,6 +243,12 @@ public:
         /// global to limit the gini improvement allowed, avoiding many insignificant cuts.
         static double s_improvement_minimum;
 
+        /** @brief restrict the variables that split may use
+        @param columns indices of the columns to try: if empty, try them all
+        */
+        static void setActive(const std::vector<int>& columns){s_active=columns;}
+        static const std::vector<int>& active(){return s_active;}
+
 
     private:
         /// the id: 1 for root, 2*parent for left, 2*parent+1 for right
@@ -240,10 +263,16 @@ public:
         double m_gini;
         /// total of signal and background weights
         double m_signal, m_background;
+        /// with several classes, the total weight of each
+        std::vector<double> m_class_weights;
+        /// with several classes, while splitting: the weight of each up to each record, in sorted order
+        std::vector<double> m_cumulative;
         /// pointers to child nodes (zero if this is a leaf node)
         Node* m_left;
         Node* m_right;
 
+        /// columns to consider for splitting, all if empty
+        static std::vector<int> s_active;
     };
     //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
@@ -286,7 +315,7 @@ public:
     /// Return the error for the model, defined as the 
     double error(const Classifier::Table& data, double purity=0.5)const;
 
-    /// create a  decision tree from the tree created by training.
+    /// create a  decision tree from the tree created by training, with the weight and gini improvement of each node.
     DecisionTree* createTree(std::string title="Decision Tree", double weight=1.);
 #if 0
     static  Classifier::SplitCriterion Classifier::splitCriterion; 
@@ -0,0 +1,397 @@
+/** @file  CompiledTree.h
+    @brief declaration of class CompiledTree
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_CompiledTree_h
+#define classifier_CompiledTree_h
+#include <vector>
+#include <stdexcept>
+
+/** @class CompiledTree
+@brief The trees of a DecisionTree, flattened into one contiguous array of nodes for evaluation.
+
+Each tree is stored starting at its root. The two children of a branch node are adjacent,
+left first, so that a step down the tree is an index computation rather than a pointer load.
+The pairs are in depth-first order, the hot child's pair (see DecisionTree::optimizeLayout)
+first, so that the likely path through the tree is contiguous in memory.
+
+The evaluation is the same as DecisionTree: the weighted average of the leaf values, where
+a tree with weight not positive is a filter that must return 0 or 1.
+
+The trees may also have several outputs, such as the purity for each of several classes: each
+leaf of a tree that is not a filter then has, besides its value, a vector of outputs(), stored
+in one array for all the trees. evaluateAll averages them all, in the same traversal.
+
+Built by DecisionTree::compile from DecisionTree::addNode, or directly from the text file
+by TreeReader.
+Once built, it is not changed by evaluation: the const methods may be called from any number
+of threads at once, on the same object. See ParallelScorer for a parallel driver.
+*/
+class CompiledTree {
+public:
+    /// a node, either a branch or a leaf
+    struct Node {
+        double value;        ///< the cut value for a branch, or the leaf value
+        int index;           ///< index of the variable to test, -1 for a leaf
+        unsigned int child;  ///< for a branch, position of the left child relative to the tree start.
+                             ///< For a leaf with outputs, position of them in values()
+        bool isLeaf()const{return index<0;}
+    };
+    /// training statistics of a node, if kept: see DecisionTree::addNode
+    struct Statistics {
+        double cover;        ///< weight of the training events reaching the node
+        double gain;         ///< for a branch, the decrease of the split criterion
+    };
+    /// location of a tree in the node array
+    struct Tree {
+        double weight;       ///< tree weight, not positive for a filter
+        unsigned int offset; ///< position of the root node
+    };
+
+    CompiledTree():m_data(0), m_size(0), m_outputs(1), m_values(0), m_value_count(0), m_width(0), m_total_weight(0),
+        m_rest_low(1,0.), m_rest_high(1,0.){}
+
+    /// copy: the nodes are always copied, even if the original is a view
+    CompiledTree(const CompiledTree& other);
+    CompiledTree& operator=(const CompiledTree& other);
+
+    /** @brief use nodes stored elsewhere, such as a mapped file, without copying them
+        @param nodes all the nodes, which must remain valid while this object, but not copies
+        of it, is used
+        @param count the number of nodes
+        @param trees the weight and root position of each tree, in order
+
+        Throws std::invalid_argument if a root or child position is out of range, or a child
+        is not after its parent.
+    */
+    void view(const Node* nodes, size_t count, const std::vector<Tree>& trees);
+
+    /** @brief as view, for trees with several outputs
+        @param outputs the number of outputs of each leaf of the trees that are not filters
+        @param values the outputs of the leaves, which must remain valid as the nodes
+        @param value_count the size of values
+
+        Also throws if the outputs of a leaf are out of range.
+    */
+    void view(const Node* nodes, size_t count, const std::vector<Tree>& trees,
+        unsigned int outputs, const double* values, size_t value_count);
+
+    /** @brief replace the contents, taking the nodes, which are swapped out of the vector
+        @param nodes all the nodes, the trees one after the other
+        @param trees the weight and root position of each tree, in order
+
+        Checked as view. Faster than addTree for each tree, which sets up accept every time.
+    */
+    void adopt(std::vector<Node>& nodes, const std::vector<Tree>& trees);
+
+    /// as adopt, with the statistics of each node, also swapped out
+    void adopt(std::vector<Node>& nodes, const std::vector<Tree>& trees, std::vector<Statistics>& statistics);
+
+    /// as adopt, for trees with several outputs: the values are also swapped out
+    void adopt(std::vector<Node>& nodes, const std::vector<Tree>& trees, std::vector<Statistics>& statistics,
+        unsigned int outputs, std::vector<double>& values);
+
+    /** @brief append a tree
+        @param weight the tree weight
+        @param nodes the nodes, root first, with child positions relative to it
+        @param statistics [none] the statistics of each node. If some trees have them and others
+        not, those of the others are zero
+    */
+    void addTree(double weight, const std::vector<Node>& nodes,
+        const std::vector<Statistics>& statistics=std::vector<Statistics>());
+
+    /** @brief append a tree with several outputs
+        @param weight the tree weight, which must be positive
+        @param nodes the nodes, each leaf with the position of its outputs in values
+        @param statistics the statistics of each node, or empty
+        @param outputs the number of outputs, the same for all the trees that are not filters
+        @param values the outputs of the leaves
+    */
+    void addTree(double weight, const std::vector<Node>& nodes, const std::vector<Statistics>& statistics,
+        unsigned int outputs, const std::vector<double>& values);
+
+    /// a visitor that ignores the nodes: the default for evaluate and walk
+    struct NoVisit {
+        void operator()(size_t)const{}
+    };
+
+    /// evaluate one tree, returning the value of the leaf selected by the values
+    template<class C>
+    double evaluate(unsigned int tree, const C& values)const
+    {
+        NoVisit none;
+        return evaluate(tree, values, none);
+    }
+
+    /** @brief evaluate one tree, calling visit(position) for each node on the path, including
+        the leaf, where position is in the array of all nodes
+    */
+    template<class C, class V>
+    double evaluate(unsigned int tree, const C& values, V& visit)const
+    {
+        const Node* root = m_data + m_trees[tree].offset;
+        const Node* node = root;
+        visit(node - m_data);
+        while( !node->isLeaf() ){
+            node = root + node->child + (values[node->index] < node->value ? 0 : 1);
+            visit(node - m_data);
+        }
+        return node->value;
+    }
+
+    /** @brief evaluate the trees: weighted average, after filters
+        @param values the source of values, indexed by variable
+        @param tree_count [0] if nonzero, the maximum number of trees, not counting filters,
+        which are always applied
+    */
+    template<class C>
+    double operator()(const C& values, unsigned int tree_count=0)const
+    {
+        NoVisit none;
+        return walk(values, none, tree_count);
+    }
+
+    /** @brief evaluate the trees as operator(), reporting each node visited, see evaluate
+        @param values the source of values, indexed by variable
+        @param visit called with the position of each node visited. With NoVisit, it costs nothing
+        @param tree_count [0] if nonzero, the maximum number of trees, not counting filters
+    */
+    template<class C, class V>
+    double walk(const C& values, V& visit, unsigned int tree_count=0)const
+    {
+        double weighted_sum=0, sum_of_weights=0;
+        unsigned int used=0;
+        for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+            double weight = m_trees[tree].weight;
+            if( weight <= 0. ){
+                // this is a filter: if zero result, just return
+                double value = evaluate(tree, values, visit);
+                if( value == 0) return 0;
+                if( value != 1.0 ) badFilter();
+                continue;
+            }
+            if( tree_count>0 && used==tree_count ) continue; // only filters from now on
+            ++used;
+            sum_of_weights += weight;
+            weighted_sum += weight * evaluate(tree, values, visit);
+        }
+        // note that if there were no trees, we accept.
+        return sum_of_weights != 0 ? weighted_sum/sum_of_weights : 1;
+    }
+
+    /// the leaf of one tree selected by the values
+    template<class C>
+    const Node* leaf(unsigned int tree, const C& values)const
+    {
+        const Node* root = m_data + m_trees[tree].offset;
+        const Node* node = root;
+        while( !node->isLeaf() ){
+            node = root + node->child + (values[node->index] < node->value ? 0 : 1);
+        }
+        return node;
+    }
+
+    /** @brief evaluate all the outputs, with one traversal of each tree
+        @param values the source of values, indexed by variable
+        @param result output: outputs() values, each the weighted average of that output of the
+        leaves, after filters, as operator(). With one output, it is the leaf value, and the
+        result is that of operator()
+        @param tree_count [0] if nonzero, the maximum number of trees, not counting filters
+    */
+    template<class C>
+    void evaluateAll(const C& values, double* result, unsigned int tree_count=0)const
+    {
+        for( unsigned int k=0; k<m_outputs; ++k) result[k]=0;
+        double sum_of_weights=0;
+        unsigned int used=0;
+        for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+            double weight = m_trees[tree].weight;
+            if( weight <= 0. ){
+                // this is a filter: if zero result, all are zero
+                double value = leaf(tree, values)->value;
+                if( value == 0) { for( unsigned int k=0; k<m_outputs; ++k) result[k]=0; return; }
+                if( value != 1.0 ) badFilter();
+                continue;
+            }
+            if( tree_count>0 && used==tree_count ) continue; // only filters from now on
+            ++used;
+            sum_of_weights += weight;
+            const Node* node = leaf(tree, values);
+            if( m_outputs==1 ) { result[0] += weight * node->value; continue; }
+            const double* v = m_values + node->child;
+            for( unsigned int k=0; k<m_outputs; ++k) result[k] += weight * v[k];
+        }
+        for( unsigned int k=0; k<m_outputs; ++k){
+            result[k] = sum_of_weights != 0 ? result[k]/sum_of_weights : 1;
+        }
+    }
+
+    /** @brief evaluate all the outputs for a block of events, stored as rows
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param result output: outputs() values for each event, event i starting at result[i*outputs()]
+        @param tree_count [0] if nonzero, the maximum number of trees, not counting filters
+    */
+    void evaluateAll(const float* rows, size_t count, size_t stride, double* result,
+        unsigned int tree_count=0)const;
+
+    /** @brief decide if operator()(values) >= cut, evaluating as few trees as possible
+        @param values the source of values, indexed by variable
+        @param cut the cut on the weighted average
+
+        After the filters, the trees are evaluated in order of decreasing weight times range
+        of leaf values. The loop stops when the smallest and largest possible contributions
+        of the remaining trees can no longer move the average across the cut. If it is still
+        too close to call when all are done, the average is evaluated in the usual order, so
+        the decision is always the same as comparing operator() to the cut.
+    */
+    template<class C>
+    bool accept(const C& values, double cut)const
+    {
+        for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+            if( m_trees[tree].weight > 0. ) continue;
+            double value = evaluate(tree, values);
+            if( value == 0) return 0 >= cut;
+            if( value != 1.0 ) badFilter();
+        }
+        if( m_total_weight == 0 ) return 1 >= cut;
+        // margin to allow for rounding, since the order of the sum is different
+        double margin = s_margin*m_total_weight*(1+(cut<0? -cut : cut)),
+            target = cut*m_total_weight, partial=0;
+        for( unsigned int k=0; k<m_order.size(); ++k){
+            unsigned int tree = m_order[k];
+            partial += m_trees[tree].weight * evaluate(tree, values);
+            if( partial + m_rest_low[k+1] >= target + margin ) return true;
+            if( partial + m_rest_high[k+1] < target - margin ) return false;
+        }
+        return (*this)(values) >= cut;
+    }
+
+    /** @brief evaluate a block of events, stored as rows
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param scores output array of count values, same as operator() for each row
+        @param tree_count [0] if nonzero, the maximum number of trees, not counting filters
+
+        The loop is over trees, then events, in blocks of s_block events, so that a tree stays
+        in cache while the events pass through it. Filters are applied first, and only events
+        that survive them are passed to the other trees.
+    */
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores,
+        unsigned int tree_count=0)const;
+
+    /** @brief evaluate a block of events, stored as columns
+        @param columns variable j of event i is columns[j][i]
+        @param count number of events
+        @param scores output array of count values
+        @param tree_count [0] if nonzero, the maximum number of trees, not counting filters
+    */
+    void evaluate(const float* const* columns, size_t count, double* scores,
+        unsigned int tree_count=0)const;
+
+    /// number of events processed together by the block evaluation
+    static const unsigned int s_block = 256;
+
+    /** @brief find the leaf reached by each of a set of rows, in one tree
+        @param root root node of the tree
+        @param rows row-major matrix of count rows
+        @param stride distance between rows
+        @param count number of rows
+        @param leaves output: the leaf values
+
+        Several events go down the tree in lockstep, 8 with AVX2 or 16 with AVX-512, using
+        gathers for the nodes and variables, and compare-and-select for the next node.
+        The instruction set is chosen at run time, with a scalar loop if neither is available.
+        The kernels address the rows with 32-bit offsets, so they are given chunks of fewer than
+        INT_MAX/stride rows, and a stride too large for one row goes to the scalar loop.
+        The stride must be at least the largest variable index used by the tree, plus one.
+    */
+    static void selectLeaves(const Node* root, const float* rows, size_t stride, size_t count, double* leaves);
+
+    /// name of the selectLeaves kernel in use
+    static const char* simdLevel();
+
+    /// set false to force the scalar selectLeaves kernel
+    static bool s_simd;
+
+    /// relative margin used by accept to allow for rounding
+    static double s_margin;
+
+    unsigned int treeCount()const{return m_trees.size();}
+    const Tree& tree(unsigned int i)const{return m_trees[i];}
+    /// the root node of tree i
+    const Node* root(unsigned int i)const{return m_data + m_trees[i].offset;}
+    /// number of nodes in tree i
+    size_t treeSize(unsigned int i)const
+    {
+        return (i+1<m_trees.size()? m_trees[i+1].offset : m_size) - m_trees[i].offset;
+    }
+    /// total number of nodes
+    size_t size()const{return m_size;}
+    /// all the nodes, the trees one after the other
+    const Node* nodes()const{return m_data;}
+    /// true if the training statistics of the nodes are kept
+    bool hasStatistics()const{return !m_statistics.empty();}
+    /// the statistics of the nodes of tree i, parallel to root(i), or zero if not kept
+    const Statistics* statistics(unsigned int i)const
+    {
+        return m_statistics.empty()? 0 : &m_statistics[m_trees[i].offset];
+    }
+    /// number of outputs of each leaf, 1 unless the trees have several
+    unsigned int outputs()const{return m_outputs;}
+    /// the outputs of all the leaves, if more than one: see Node::child
+    const double* values()const{return m_values;}
+    size_t valueCount()const{return m_value_count;}
+    /// the outputs of a leaf of a tree that is not a filter, if more than one
+    const double* outputs(const Node& leaf)const{return m_values + leaf.child;}
+    /// number of variables needed: one more than the largest index used
+    int width()const{return m_width;}
+
+    void clear(){ *this = CompiledTree(); }
+
+private:
+    static void badFilter();
+
+    template<class Rows>
+    void evaluateBlock(const Rows& rows, size_t count, double* scores, unsigned int tree_count)const;
+
+    /// set up the order and bounds used by accept
+    void setupOrder();
+
+    /// set up the width, and the bounds used by accept, from the nodes
+    void setupTrees();
+
+    /// throw if a root or child position, or the outputs of a leaf, are out of range, or a child is not after its parent
+    static void check(const Node* nodes, size_t count, const std::vector<Tree>& trees,
+        unsigned int outputs=1, size_t value_count=0);
+
+    /// set the number of outputs for a tree being added, if it is the same as the others
+    void addOutputs(double weight, unsigned int outputs);
+
+    /// append a tree whose leaf outputs, if any, are already in place
+    void append(double weight, const std::vector<Node>& nodes, const std::vector<Statistics>& statistics);
+
+    std::vector<Node> m_nodes;  ///< storage for the nodes, unless a view
+    const Node* m_data;         ///< the nodes: either &m_nodes[0], or a view
+    size_t m_size;              ///< number of nodes
+    std::vector<Tree> m_trees;
+    std::vector<Statistics> m_statistics; ///< empty, or one for each node
+    unsigned int m_outputs;     ///< number of outputs of a leaf
+    std::vector<double> m_value_data; ///< storage for the outputs, if more than one, unless a view
+    const double* m_values;     ///< the outputs: either &m_value_data[0], or a view
+    size_t m_value_count;
+    int m_width;
+
+    // for accept: the trees that are not filters, and bounds on their contributions
+    double m_total_weight;           ///< sum of weights
+    std::vector<double> m_low, m_high; ///< for each tree, the smallest and largest leaf values
+    std::vector<unsigned int> m_order; ///< by decreasing weight*(high-low)
+    std::vector<double> m_rest_low;  ///< for each position in m_order, smallest sum of weight*value from there on
+    std::vector<double> m_rest_high; ///< and the largest
+};
+
+#endif
@@ -0,0 +1,75 @@
+/** @file  CutChain.h
+    @brief declaration of class CutChain
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_CutChain_h
+#define classifier_CutChain_h
+
+#include "classifier/CompiledTree.h"
+#include <vector>
+
+/** @class CutChain
+@brief A filter tree made by Filter, as a list of cuts applied to a block of events a column at a time.
+
+A Filter makes a chain: each branch node has one leaf 0 child, where the event is rejected,
+and the chain continues with the other, ending with a leaf 1. That is a conjunction of cuts,
+each either value < cut or not. Each cut is applied to all surviving events of a block,
+using one column, eight or sixteen values per instruction when the processor allows. The
+result is a bit mask of the events that pass. Words of the mask that are already zero are
+skipped, and the loop stops when all are.
+
+Each cut is compared in float, against the smallest float not less than the double cut value,
+which gives exactly the same answer as the double comparison in the tree. A NaN fails a
+"<" cut and passes the other, as in the tree.
+
+Since the order of the cuts does not change the result, order() may be used to apply the
+cuts that reject the most events first.
+*/
+class CutChain {
+public:
+    typedef unsigned long long Word; ///< 64 events
+
+    /// one test
+    struct Cut {
+        int index;        ///< the variable
+        bool less;        ///< pass if value < cut, otherwise if not
+        double value;     ///< the cut, from the tree
+        float threshold;  ///< the same comparison, in float
+        double rejection; ///< fraction rejected, set by order()
+    };
+
+    /// make from a filter tree, which must be a chain: see isChain
+    CutChain(const CompiledTree& model, unsigned int tree);
+
+    /// check that a tree is a chain of cuts ending with 1
+    static bool isChain(const CompiledTree& model, unsigned int tree);
+
+    /** @brief apply the cuts to a block of events
+        @param columns variable j of event i is columns[j][i]
+        @param count number of events
+        @param mask output: (count+63)/64 words, bit i%64 of word i/64 set if event i passes
+        @return the number of events that pass
+    */
+    size_t evaluate(const float* const* columns, size_t count, Word* mask)const;
+
+    /// apply the cuts to one event: 1 or 0, as the tree
+    double operator()(const float* row)const;
+
+    /** @brief measure the fraction of a sample that each cut rejects by itself, and
+        sort the cuts by decreasing rejection
+    */
+    void order(const float* const* columns, size_t count);
+
+    size_t size()const{return m_cuts.size();}
+    const Cut& cut(size_t i)const{return m_cuts[i];}
+
+private:
+    /// bits set for the values that pass one cut, of n at most 64
+    static Word test(const Cut& cut, const float* values, size_t n);
+
+    std::vector<Cut> m_cuts;
+};
+
+#endif
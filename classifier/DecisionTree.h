@@ -13,11 +13,16 @@
 #include <iostream>
 #include <fstream>
 
+#include "classifier/CompiledTree.h"
+#include "classifier/TreeIndex.h"
+
 
 /** @class DecisionTree
 @brief Define and implement a decision tree, or set of trees, with minimal information
 
-This is a functor class, with argument an object that behaves like a vector.
+This is a functor class, with argument an object that behaves like a vector: a std::vector<float>,
+a pointer to float or double values, a Strided view, or a subclass of Values for sources
+that compute values on demand.
 
 Each tree has an associated weight, and returns a value, usually the purity from 
 the training. The function returns the weighted sum of the values. 
@@ -26,6 +31,13 @@ A special tree may be defined with zero weight: this is presumed to be a <i>filt
 and must return either 0 or 1. If 0, the function will return 0. If 1, the value will be that of 
 the subsequent trees.
 
+Evaluation uses a CompiledTree, built on first use after nodes or trees are added. Call
+compile() before sharing a DecisionTree between threads: after that, the evaluation methods,
+operator(), evaluate, evaluateAll, accept, outputs and compiled, may be called concurrently,
+until the next addNode or addTree. The other const methods, print, printCode, printFilter and
+compile itself, may build the nodes of a tree read from a file, and must not be called while
+any other thread uses the tree. A tree read from a file is already compiled; one made from a
+TreeIndex is read by compile().
 
 */
 
@@ -49,10 +61,23 @@ public:
     @param index  if non-negative, then the index of the Value object. -1 for a leaf node
     @param value  either the cut value, or the purity of a leaf node, signified by index<0. 
 
+    A node line may have two more values, the cover and gain, see addNode; print writes them if asked.
+    A tree with several outputs, see addLeaf, has their number after the weight on its id 0 line,
+    and the outputs after the value on each leaf line, before the cover and gain.
     Parent nodes must precede children; the first id must be 0 to for tree properties, then 1 for the root.
+    The file is read by TreeReader directly into the compiled form, in time linear in the number of
+    nodes; a format error throws std::runtime_error, with the line number.
     */
     DecisionTree(std::ifstream& in);
 
+    /** @brief some of the trees of a file, read when first needed
+        @param index the index of the file
+        @param trees the trees to use, in increasing order: see TreeIndex::select and TreeIndex::filters
+
+        Only the title is read now: the trees are read on first use, and the others never.
+    */
+    DecisionTree(const TreeIndex& index, const std::vector<unsigned int>& trees);
+
     /// @class Values
     /// @brief Abstract class to interface to a source of values.
     class Values {
@@ -63,12 +88,87 @@ public:
     };
     /** evaluate, returning purity of appropriate leaf node
     @param row
-    @param tree_count [0] if nonzero, maximum trees to evaluate
+    @param tree_count [0] if nonzero, maximum trees to evaluate, not counting filters,
+    which are always applied
     */
     double operator()(const std::vector<float>& row, int tree_count=0) const;
 
     double operator()(const Values& vals) const;
 
+    /** @brief evaluate a row in place: no copy, no virtual calls
+        @param row pointer to the values
+        @param size number of values, checked against the largest index used by the trees
+    */
+    double operator()(const float* row, size_t size) const;
+    double operator()(const double* row, size_t size) const;
+
+    /** @brief evaluate any source of values with operator[](int), such as a pointer, a vector or
+        a Strided view. Inlined, for sources that are neither float nor double arrays.
+    */
+    template<class C>
+    double evaluate(const C& values)const{ return compiled()(values); }
+
+    /// @class Strided
+    /// @brief view of values spaced by a stride, such as an event in a column-major matrix
+    template<class T>
+    class Strided {
+    public:
+        Strided(const T* data, size_t stride): m_data(data), m_stride(stride){}
+        T operator[](int index)const{return m_data[index*m_stride];}
+    private:
+        const T* m_data;
+        size_t m_stride;
+    };
+
+    /** @brief evaluate a block of events, stored as rows. See CompiledTree::evaluate
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows, checked as the size for operator()
+        @param scores output: count values, each the same as operator() for that row
+        @param tree_count [0] if nonzero, maximum trees to evaluate, not counting filters
+    */
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores, int tree_count=0)const;
+
+    /** @brief evaluate a block of events, stored as columns
+        @param columns variable j of event i is columns[j][i]
+        @param count number of events
+        @param scores output: count values
+        @param tree_count [0] if nonzero, maximum trees to evaluate, not counting filters
+    */
+    void evaluate(const float* const* columns, size_t count, double* scores, int tree_count=0)const;
+
+    /** @brief decide if the value for a row would pass a cut, stopping as soon as the
+        remaining trees cannot change the answer. See CompiledTree::accept
+        @param row pointer to the values
+        @param size number of values, checked as for operator()
+        @param cut the cut on the value
+        @return the same as operator()(row, size) >= cut
+    */
+    bool accept(const float* row, size_t size, double cut)const;
+    bool accept(const std::vector<float>& row, double cut)const{return accept(&row[0], row.size(), cut);}
+
+    /** @brief evaluate all the outputs, with one traversal of each tree. See addLeaf
+        @param row pointer to the values
+        @param size number of values, checked as for operator()
+        @param result output: outputs() values, each the weighted average of that output of the leaves,
+        or 0 if a filter fails. With one output, it is the same as operator()
+        @param tree_count [0] if nonzero, maximum trees to evaluate, not counting filters
+    */
+    void evaluateAll(const float* row, size_t size, double* result, int tree_count=0)const;
+    void evaluateAll(const std::vector<float>& row, std::vector<double>& result, int tree_count=0)const;
+
+    /** @brief evaluate all the outputs for a block of events, stored as rows
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows, checked as the size for operator()
+        @param result output: outputs() values for each event, event i starting at result[i*outputs()]
+        @param tree_count [0] if nonzero, maximum trees to evaluate, not counting filters
+    */
+    void evaluateAll(const float* rows, size_t count, size_t stride, double* result, int tree_count=0)const;
+
+    /// number of outputs of the trees: 1 unless the leaves were added by addLeaf
+    unsigned int outputs()const{return compiled().outputs();}
+
     ~DecisionTree();
 
     
@@ -79,6 +179,26 @@ public:
     */
     void addNode(Identifier_t id, int index, double value);
 
+    /**@brief add a node, with its training statistics
+        @param id, index, value as above
+        @param cover the weight of the training events reaching the node
+        @param gain for a branch, the decrease of the split criterion, as Classifier::rateVariables
+
+        A tree with statistics can be explained, see TreeExplainer. Nodes added without them have zero.
+    */
+    void addNode(Identifier_t id, int index, double value, double cover, double gain);
+
+    /**@brief add a leaf with several outputs, such as the purity for each class
+        @param id the node id, as addNode
+        @param value the leaf value, used by operator()
+        @param outputs the outputs, used by evaluateAll. All the leaves of the trees that are not
+        filters must have the same number
+    */
+    void addLeaf(Identifier_t id, double value, const std::vector<double>& outputs);
+
+    /// add a leaf with several outputs, and the weight of the training events reaching it
+    void addLeaf(Identifier_t id, double value, const std::vector<double>& outputs, double cover);
+
     /**@brief add DecisionTree
         @param tree DecisionTree to be appended
 
@@ -86,9 +206,55 @@ public:
     */
     void addTree(const DecisionTree * tree);
 
-    void print(std::ostream& out=std::cout)const;
+    /** @brief write the trees in the format read by the constructor
+        @param out [cout] the stream
+        @param statistics [false] if true, and the nodes have them, append the cover and gain to each
+        node line. The file is then not readable by versions before they were added
+    */
+    void print(std::ostream& out=std::cout, bool statistics=false)const;
     std::string title()const{ return m_title;}
 
+    /** @brief write C++ source for a function that evaluates the trees, with no run-time data.
+        @param out output stream
+        @param name name of the function, declared extern "C" as
+        @verbatim
+        double name(const float* row);
+        void name_block(const float* rows, size_t count, size_t stride, double* scores);
+        @endverbatim
+        Each tree becomes nested comparisons, with all indices and values as constants,
+        printed to full precision. The result is bit-for-bit the same as operator(), if compiled
+        without contraction to fused multiply-add. It may be built as a shared library, and
+        loaded with GeneratedTree.
+    */
+    void printCode(std::ostream& out, const std::string& name)const;
+
+    /** @brief the flat form of the trees, used for evaluation.
+    It is rebuilt, if nodes or trees were added since, on first use.
+    */
+    const CompiledTree& compiled()const;
+
+    /// build the flat form now, if nodes or trees were added since it was last built; nothing otherwise
+    void compile()const;
+
+    /** @brief arrange the nodes for the events expected, from a calibration sample
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+
+        At each branch, the child taken more often by the sample becomes the hot one. In the
+        compiled form, the children of the hot child follow immediately after the pair containing
+        it, so that the likely path is contiguous; in the generated code, the comparison is
+        written so that the likely outcome is the first branch. print writes the hot child first,
+        and reading the file back restores the choice. Evaluation is not changed.
+        Trees appended to another DecisionTree by addTree share their nodes, and so this choice.
+    */
+    void optimizeLayout(const float* rows, size_t count, size_t stride);
+
+    /** @brief remove the nodes that cannot change the value: see TreeSimplifier
+        @param merge [false] also merge trees with the same tests, which changes the value by rounding
+    */
+    void simplify(bool merge=false);
+
 
     /** @brief formatted print of the tree, assuming it is a filter.
         @param varnames list of corresponding variable names
@@ -103,9 +269,21 @@ public:
 
 private:
     Node* find(Identifier_t id);
-    void printNode(std::ostream& out , const DecisionTree::Node * node, Identifier_t id)const;
+    void printNode(std::ostream& out , const DecisionTree::Node * node, Identifier_t id, bool statistics)const;
+    void printCodeNode(std::ostream& out , const DecisionTree::Node * node, int depth)const;
+    void compileNode(std::vector<CompiledTree::Node>& nodes, std::vector<CompiledTree::Statistics>* statistics,
+        std::vector<double>& values, const DecisionTree::Node * node, unsigned int position)const;
+    /// make m_rootlist from m_compiled, if it was read from a file and the nodes are needed
+    void expand()const;
+    /// read the trees from the index, if not done yet
+    void load()const;
 
-    std::vector<std::pair<double, Node*> > m_rootlist; ///< vector of pointers to root nodes
+    mutable std::vector<std::pair<double, Node*> > m_rootlist; ///< vector of pointers to root nodes
     std::string m_title;
+    mutable CompiledTree m_compiled; ///< flat copy of the trees in m_rootlist
+    mutable bool m_stale;            ///< set when m_compiled needs to be rebuilt
+    mutable bool m_statistics;       ///< set if any node has training statistics
+    TreeIndex m_index;               ///< for trees read on first use
+    mutable std::vector<unsigned int> m_pending; ///< the trees still to be read from m_index
 };
 #endif
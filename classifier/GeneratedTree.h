@@ -0,0 +1,61 @@
+/** @file  GeneratedTree.h
+    @brief declaration of class GeneratedTree
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_GeneratedTree_h
+#define classifier_GeneratedTree_h
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/** @class GeneratedTree
+@brief Load a function written by DecisionTree::printCode from a shared library.
+
+Example of usage
+@verbatim
+   std::ofstream src("mytree.cpp");
+   dtree.printCode(src, "mytree");
+   // c++ -O2 -shared -fPIC -ffp-contract=off -o mytree.so mytree.cpp
+   GeneratedTree gtree("./mytree.so", "mytree");
+   double value = gtree(row); // same as dtree(row)
+@endverbatim
+
+*/
+class GeneratedTree {
+public:
+    typedef double (*Function)(const float* row);
+    typedef void (*BlockFunction)(const float* rows, size_t count, size_t stride, double* scores);
+
+    /** @brief open the library, and find the functions
+        @param library path to the shared library
+        @param name the name given to DecisionTree::printCode
+
+        Throws std::runtime_error if the library or functions are not found
+    */
+    GeneratedTree(const std::string& library, const std::string& name);
+
+    /// closes the library
+    ~GeneratedTree();
+
+    double operator()(const float* row)const{return m_function(row);}
+    double operator()(const std::vector<float>& row)const{return m_function(&row[0]);}
+
+    /// evaluate a block of rows, see DecisionTree::evaluate
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const{
+        m_block(rows, count, stride, scores);
+    }
+
+private:
+    // not copyable: owns the library handle
+    GeneratedTree(const GeneratedTree&);
+    GeneratedTree& operator=(const GeneratedTree&);
+
+    void* m_handle;
+    Function m_function;
+    BlockFunction m_block;
+};
+
+#endif
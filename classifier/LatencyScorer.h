@@ -0,0 +1,73 @@
+/** @file  LatencyScorer.h
+    @brief declaration of class LatencyScorer
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_LatencyScorer_h
+#define classifier_LatencyScorer_h
+
+#include "classifier/CompiledTree.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/** @class LatencyScorer
+@brief Evaluate one event at a time, with the trees divided among a small group of threads.
+
+The trees are split into contiguous groups with about the same number of nodes, one for the
+calling thread and one for each worker. For each event, the caller publishes the row, and each
+thread finds the leaf values of its trees. The workers wait for the next event by spinning, not
+sleeping, so that starting them costs only a cache line transfer; they can be pinned to cores.
+The caller then combines the leaf values in tree order, so the result is identical to
+DecisionTree::operator().
+
+The workers use their cores even when idle, after s_spin pauses they yield, but keep polling.
+This is for dedicated, latency-bound use: for throughput use ParallelScorer.
+operator() is not reentrant: each thread that scores events needs its own LatencyScorer.
+*/
+class LatencyScorer {
+public:
+    /** @brief copy the model, and start the workers
+        @param model the compiled trees
+        @param nthreads [4] number of threads, including the caller, at most one per core
+        @param first_cpu [-1] if not negative, pin worker i to this cpu plus i (Linux only)
+    */
+    explicit LatencyScorer(const CompiledTree& model, unsigned int nthreads=4, int first_cpu=-1);
+    ~LatencyScorer();
+
+    /// evaluate one event
+    double operator()(const float* row);
+    double operator()(const std::vector<float>& row){return (*this)(&row[0]);}
+
+    /// number of threads, including the caller
+    unsigned int threads()const{return m_threads.size()+1;}
+
+    /// number of pause instructions while waiting before yielding the processor
+    static unsigned int s_spin;
+
+private:
+    LatencyScorer(const LatencyScorer&);
+    LatencyScorer& operator=(const LatencyScorer&);
+
+    /// worker loop for group part
+    void work(unsigned int part);
+    /// leaf values of the trees in group part
+    void evaluate(unsigned int part, const float* row);
+
+    const CompiledTree m_model;
+    std::vector<unsigned int> m_first;  ///< first tree of each group, plus the end
+    std::vector<size_t> m_start;        ///< position in m_leaves of the first tree of each group
+    std::vector<double> m_leaf_store;   ///< space for m_leaves, with room to align it
+    double* m_leaves;                   ///< leaf value of each tree, each group from its own cache line
+    std::vector<std::thread> m_threads;
+
+    // written by the caller, read by the workers, and the reverse: on separate cache lines
+    alignas(64) const float* m_row;
+    std::atomic<unsigned long> m_generation; ///< incremented for each event
+    std::atomic<bool> m_stop;
+    alignas(64) std::atomic<unsigned int> m_finished; ///< number of workers done with this event
+};
+
+#endif
@@ -0,0 +1,97 @@
+/** @file  ModelFile.h
+    @brief declaration of class ModelFile
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_ModelFile_h
+#define classifier_ModelFile_h
+
+#include "classifier/CompiledTree.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+class DecisionTree;
+
+/** @class ModelFile
+@brief A model in a binary file, mapped into memory and used in place.
+
+The file holds the CompiledTree node array exactly as in memory, the tree weights and
+positions, the title, and the names of the variables. Opening it maps the file read-only,
+checks the header and, optionally, a checksum of the contents, then uses the nodes where they
+are: there is no parsing, and no allocation per node. Processes that open the same file share
+the pages.
+
+The format is for the machine that wrote it: the header records the byte order, version and
+node size, and a file that does not match is rejected. Convert from text with write(), and
+back with print(), or use the model_convert program.
+
+Layout, all offsets from the start of the file:
+@verbatim
+   header     magic "DTREEBIN", byte order, version, sizes, counts, offsets, checksum
+   outputs    version 2 only: {number of outputs, value count, offset of the values}
+   trees      tree_count records of {double weight; unsigned long long offset}
+   nodes      node_count CompiledTree::Node, 16 byte aligned
+   values     version 2 only: the leaf outputs, see CompiledTree::values
+   strings    the title, then each variable name, each ending with '\0'
+@endverbatim
+Version 2 is written only for trees with several outputs, so that other files can still be read
+by programs that know only version 1.
+*/
+class ModelFile {
+public:
+    /** @brief map a file
+        @param filename the file
+        @param verify [true] check the checksum, which reads the whole file
+
+        Throws std::invalid_argument if the file cannot be opened, std::runtime_error if it is not
+        a valid model file for this machine
+    */
+    explicit ModelFile(const std::string& filename, bool verify=true);
+
+    /// unmaps the file
+    ~ModelFile();
+
+    /// the trees: a view of the mapped nodes, valid while this object exists
+    const CompiledTree& model()const{return m_model;}
+    const std::string& title()const{return m_title;}
+    const std::vector<std::string>& variables()const{return m_vars;}
+
+    /// write the trees in the text format of DecisionTree::print, which the DecisionTree constructor reads,
+    /// with 17 digits so that the values read back are the same
+    void print(std::ostream& out=std::cout)const;
+
+    /** @brief write a binary file
+        @param filename the file
+        @param dtree the trees
+        @param vars the names of the variables, in the order of the tree indices
+    */
+    static void write(const std::string& filename, const DecisionTree& dtree, const std::vector<std::string>& vars);
+    static void write(const std::string& filename, const CompiledTree& model, const std::string& title,
+        const std::vector<std::string>& vars);
+
+    /// check the first bytes of the file for the magic string
+    static bool isModelFile(const std::string& filename);
+
+    /// latest version of the format: see the layout
+    static const unsigned int s_version = 2;
+
+private:
+    // not copyable: owns the mapping
+    ModelFile(const ModelFile&);
+    ModelFile& operator=(const ModelFile&);
+
+    void unmap();
+    void printNode(std::ostream& out, unsigned int tree, unsigned int node, long long id)const;
+
+    void* m_address;
+    size_t m_length;
+    void* m_handle; ///< file mapping handle, for WIN32
+    CompiledTree m_model;
+    std::string m_title;
+    std::vector<std::string> m_vars;
+};
+
+#endif
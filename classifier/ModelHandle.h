@@ -0,0 +1,136 @@
+/** @file  ModelHandle.h
+    @brief declaration of class ModelHandle
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_ModelHandle_h
+#define classifier_ModelHandle_h
+
+#include "classifier/DecisionTree.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** @class ModelHandle
+@brief The current DecisionTree from a file, replaced while in use when the file changes.
+
+A new model is read, already compiled, by the thread calling reload, or by a watcher thread that
+checks the modification time and size of the file, away from the evaluating threads. It is
+then published by an atomic pointer exchange: an evaluation already started finishes with the
+old model, and the next one uses the new.
+
+Readers never lock or wait. Each one counts itself in, on one of two counters, before loading
+the pointer, and out after; the counters are spread over several cache lines, by thread. The
+old model is deleted once both counters have been seen at zero, the current one switched
+in between so that new readers do not hold it up: any reader that could have the old model
+has then finished. This is the scheme of sleepable RCU, and the waiting is all in reload.
+
+A file that cannot be read, for example while it is being written, leaves the current model
+in place. The watcher records the error, see lastError, and tries again when the file changes.
+*/
+class ModelHandle {
+public:
+    /** @brief read the model
+        @param filename the text file, as written by DecisionTree::print
+        @param poll [0] if nonzero, the interval in seconds at which a watcher thread checks the file
+
+        Throws if the file cannot be read.
+    */
+    explicit ModelHandle(const std::string& filename, double poll=0);
+    ~ModelHandle();
+
+    /// @class Reader
+    /// @brief holds the current model while in scope. Lock free; do not keep it long.
+    class Reader {
+    public:
+        explicit Reader(const ModelHandle& handle);
+        ~Reader();
+        const DecisionTree& operator*()const{return *m_model;}
+        const DecisionTree* operator->()const{return m_model;}
+    private:
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+        std::atomic<long>& m_count;
+        const DecisionTree* m_model;
+    };
+
+    /// evaluate with the current model
+    template<class C>
+    double operator()(const C& values)const
+    {
+        Reader model(*this);
+        return model->evaluate(values);
+    }
+
+    /// evaluate a block of events, all with the same model. See DecisionTree::evaluate
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const;
+
+    /** @brief read the file now, and publish it. Throws if it cannot be read, leaving the current model
+
+        Not from a thread that holds a Reader: it would wait for that Reader to finish, forever.
+    */
+    void reload();
+
+    /** @brief publish a model made elsewhere
+        @param model the new model, which is compiled here, if it is not already, and deleted by this object
+
+        Not from a thread that holds a Reader, as reload.
+    */
+    void publish(DecisionTree* model);
+
+    /// number of models published so far, including the first
+    unsigned long generation()const{return m_generation;}
+
+    /// the message if the last attempt of the watcher to read the file failed, or empty
+    std::string lastError()const;
+
+    const std::string& filename()const{return m_filename;}
+
+    /// number of reader counter pairs
+    static const unsigned int s_stripes = 16;
+
+private:
+    ModelHandle(const ModelHandle&);
+    ModelHandle& operator=(const ModelHandle&);
+
+    /// the counters for one group of threads, on its own cache line
+    struct alignas(64) Stripe {
+        std::atomic<long> count[2];
+    };
+
+    /// the counter for the calling thread, chosen by the current phase
+    std::atomic<long>& enter()const;
+
+    /// wait until no reader can still have a model loaded before this call
+    void synchronize();
+
+    /// modification time and size of the file, zero if it cannot be found
+    void stamp(long long& time, long long& size)const;
+
+    /// watcher loop
+    void watch();
+
+    std::string m_filename;
+    std::atomic<DecisionTree*> m_current;
+    std::atomic<unsigned int> m_phase;   ///< which counter of the pair readers use
+    mutable Stripe m_stripes[s_stripes];
+    std::atomic<unsigned long> m_generation;
+
+    std::mutex m_publish;                ///< serializes reload and publish
+    long long m_time, m_size;            ///< stamp of the file last read
+
+    // the watcher
+    double m_poll;
+    std::thread m_watcher;
+    mutable std::mutex m_mutex;          ///< protects the rest
+    std::condition_variable m_wake;
+    bool m_stop;
+    std::string m_error;
+};
+
+#endif
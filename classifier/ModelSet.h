@@ -0,0 +1,79 @@
+/** @file  ModelSet.h
+    @brief declaration of class ModelSet
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_ModelSet_h
+#define classifier_ModelSet_h
+
+#include "classifier/CompiledTree.h"
+
+#include <string>
+#include <vector>
+
+class DecisionTree;
+
+/** @class ModelSet
+@brief Several DecisionTree models, each trained with its own list of variables, evaluated
+together from one row.
+
+The variables of the set are the union of those of the models, in order of first appearance.
+Each model is copied with its variable indices changed to positions in that union, so one
+row, filled once per event in the order of variables(), serves all the models.
+
+@verbatim
+   ModelSet set;
+   set.add("low_energy");     // folders with dtree.txt and variables.txt
+   set.add("high_energy");
+   tuple.selectColumns(set.variables(), false);
+   std::vector<double> scores(set.size());
+   set.evaluate(&tuple[i][0], &scores[0]);
+@endverbatim
+*/
+class ModelSet {
+public:
+    ModelSet(){}
+
+    /** @brief add a model
+        @param dtree the trees, which are copied
+        @param vars the names of the variables, in the order of the indices used by the trees
+        @return the position of the model in the set
+    */
+    unsigned int add(const DecisionTree& dtree, const std::vector<std::string>& vars);
+
+    /** @brief add a model from a tree information folder, as used by RootDecision
+        @param treeInfoFolder folder with the files dtree.txt and variables.txt
+    */
+    unsigned int add(const std::string& treeInfoFolder);
+
+    /// all the variables used, in the order expected in a row
+    const std::vector<std::string>& variables()const{return m_vars;}
+
+    /// evaluate all the models for one event: scores has size() entries
+    void evaluate(const float* row, double* scores)const;
+
+    /** @brief evaluate all the models for a block of events
+        @param rows row-major matrix: variable j, as in variables(), of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param scores output: the score of model m for event i is scores[m*count+i]
+    */
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const;
+
+    /// number of models
+    unsigned int size()const{return m_models.size();}
+    /// the model, with indices into variables()
+    const CompiledTree& model(unsigned int i)const{return m_models[i];}
+    const std::string& title(unsigned int i)const{return m_titles[i];}
+
+private:
+    /// position of a variable in the union, added if new
+    int position(const std::string& name);
+
+    std::vector<std::string> m_vars;
+    std::vector<CompiledTree> m_models;
+    std::vector<std::string> m_titles;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/** @file  ParallelScorer.h
+    @brief declaration of class ParallelScorer
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_ParallelScorer_h
+#define classifier_ParallelScorer_h
+
+#include "classifier/CompiledTree.h"
+#include "classifier/ThreadPool.h"
+
+class DecisionTree;
+
+/** @class ParallelScorer
+@brief Evaluate large blocks of events on all cores, with a private copy of the compiled model.
+
+The model is copied when the scorer is made, and never changed afterwards, so later changes
+to the DecisionTree do not affect it. A block is cut into slices of s_slice events, and each
+slice is evaluated by CompiledTree::evaluate into its own part of the output. Every event is
+evaluated exactly as by one thread, so the result does not depend on the number of threads.
+
+The evaluate methods may be called from several threads; the calls are run one at a time.
+*/
+class ParallelScorer {
+public:
+    /** @brief copy the compiled model
+        @param dtree the trees
+        @param nthreads [0] number of threads, including the caller; zero means one per core
+    */
+    explicit ParallelScorer(const DecisionTree& dtree, unsigned int nthreads=0);
+    explicit ParallelScorer(const CompiledTree& model, unsigned int nthreads=0);
+
+    /** @brief evaluate a block of events, stored as rows. See CompiledTree::evaluate
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param scores output array of count values
+    */
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const;
+
+    /** @brief evaluate a block of events, stored as columns
+        @param columns variable j of event i is columns[j][i], for j up to model().width()-1
+        @param count number of events
+        @param scores output array of count values
+    */
+    void evaluate(const float* const* columns, size_t count, double* scores)const;
+
+    /// the model, which may also be used directly from any thread
+    const CompiledTree& model()const{return m_model;}
+
+    /// number of threads
+    unsigned int threads()const{return m_pool.size();}
+
+    /// number of events given to a thread at a time
+    static size_t s_slice;
+
+private:
+    const CompiledTree m_model;
+    mutable ThreadPool m_pool;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/** @file  QuickScorer.h
+    @brief declaration of class QuickScorer
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_QuickScorer_h
+#define classifier_QuickScorer_h
+
+#include "classifier/CompiledTree.h"
+#include <vector>
+
+/** @class QuickScorer
+@brief Evaluate an ensemble with the QuickScorer algorithm, instead of walking each tree.
+
+The leaves of each tree are numbered from left to right, and each tree has a bit vector
+of the leaves that may still be reached, initially all of them. A branch node whose test fails,
+(value >= cut, going right) excludes all the leaves of its left subtree. The exit leaf is then
+the lowest bit still set.
+
+All the branch nodes of the ensemble are sorted by variable, then cut. For each event, and each
+variable, only the nodes with cut <= value are visited, ANDing their masks into the bit vectors
+of their trees. There are no unpredictable branches, and the work for all trees is interleaved.
+
+Trees with more than 64 leaves, and filters, are evaluated by walking the CompiledTree.
+The result is identical to DecisionTree::operator().
+*/
+class QuickScorer {
+public:
+    typedef unsigned long long Bits;
+
+    /// set up from a compiled model, which is copied
+    explicit QuickScorer(const CompiledTree& model);
+
+    /// evaluate one event: no allocation, unless there are more than 255 trees with bit vectors
+    double operator()(const float* row)const;
+    double operator()(const std::vector<float>& row)const{return (*this)(&row[0]);}
+
+    /** @brief evaluate a block of events
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param scores output array of count values
+    */
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const;
+
+    /// number of trees evaluated with bit vectors
+    unsigned int quickTrees()const{return m_quick.size();}
+
+private:
+    /// evaluate a row, using the bit vector workspace
+    double score(const float* row, Bits* bits)const;
+
+    CompiledTree m_model;
+    std::vector<unsigned int> m_quick;   ///< the trees handled by bit vectors
+    std::vector<int> m_quick_index;      ///< for each tree, its position in m_quick, or -1
+    std::vector<Bits> m_initial;         ///< for each quick tree, all its leaves
+    std::vector<unsigned int> m_leaf_offset; ///< for each quick tree, start in m_leaves
+    std::vector<double> m_leaves;        ///< leaf values, in left to right order
+
+    /// branch nodes, grouped by variable, sorted by cut within each group
+    std::vector<unsigned int> m_feature_offset; ///< start of each variable's group, plus end
+    std::vector<double> m_cuts;
+    std::vector<unsigned int> m_trees;   ///< the quick tree for each node
+    std::vector<Bits> m_masks;           ///< leaves still reachable if the test fails
+};
+
+#endif
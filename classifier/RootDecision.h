@@ -11,6 +11,8 @@
 #define RootDecision_h
 
 #include <string>
+#include <vector>
+#include <utility>
 
 #include "classifier/RootTuple.h"
 class DecisionTree;
@@ -58,6 +60,16 @@ public:
 
     size_t size()const{return m_tuple->size();}
 
+    /** @brief evaluate a range of entries, a block at a time
+        @param first index of the first entry
+        @param count number of entries
+        @param results the (value, weight) pairs, same as from the Iterator, are appended
+
+        The entries are read ahead by a RootPrefetch: prefer this to the Iterator for long ranges.
+    */
+    void evaluate(unsigned int first, unsigned int count, 
+        std::vector<std::pair<double,double> >& results)const;
+
     RootTuple* tuple()const{return m_tuple;}
     const DecisionTree* dtree()const{return m_dtree;}
 
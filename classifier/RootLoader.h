@@ -14,6 +14,14 @@ namespace CLHEP {class RandFlat;}
 /** @class RootLoader
     @brief subclass of Classifier::LoadData to load from a set of ROOT files 
     Called to fill a Classifier object.
+
+    The files are read in parallel, each by its own RootTuple, into separate tables that are
+    then joined in the order of the file list. The table, and the log, are the same as reading
+    them one after the other. Each file is read ahead by a RootPrefetch.
+
+    A file read ahead uses two threads: the one making its records, and the RootPrefetch
+    reader. So s_threads threads read s_threads/2 files at a time. With s_threads one, there
+    is no reader thread, and the files are read one after the other by a single thread.
 */
 class RootLoader {
 public:
@@ -34,6 +42,9 @@ public:
     void operator()(Classifier::Table& table, Subset set, std::ostream& log);
 
     double total(bool signal)const{return signal? m_signal_total : m_bkgnd_total;}
+
+    /// number of threads reading files, counting the readers ahead: zero, the default, for one per core
+    static unsigned int s_threads;
 private:
 
    /** @brief load signal or background records from set of files
@@ -0,0 +1,97 @@
+/** @file  RootPrefetch.h
+    @brief declaration of class RootPrefetch
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_RootPrefetch_h
+#define classifier_RootPrefetch_h
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class RootTuple;
+
+/** @class RootPrefetch
+@brief Read a range of rows of a RootTuple ahead of their use, a block at a time.
+
+A reader thread fills the blocks of a small ring with RootTuple::fill_block, while the
+caller works on the block it has from next. Reading and decompressing the baskets is then
+done at the same time as building records or evaluating, rather than in turn with it.
+
+The reader waits when all the blocks are full, so at most depth blocks are held. The tuple
+must not be used by anything else until the RootPrefetch is deleted. An exception from the
+reader is rethrown by next, after the blocks read before it.
+
+The reader reads the tree while the caller may use ROOT, so the first RootPrefetch to read
+ahead makes ROOT thread-safe, with enableThreads.
+
+Without read ahead there is no reader thread: next reads each block itself, in the caller's
+thread. That is for a caller that counts its threads, such as RootLoader.
+
+@verbatim
+   RootPrefetch rows(tuple, 0, tuple.size());
+   while( const RootPrefetch::Block* block = rows.next() ){
+      const std::vector<float>& x = block->columns[1];
+      ... rows block->first to block->first+block->count-1
+   }
+@endverbatim
+*/
+class RootPrefetch {
+public:
+    /// @class Block
+    /// @brief a range of rows, one array for each selected column
+    class Block {
+    public:
+        size_t first, count;
+        std::vector<std::vector<float> > columns;
+    };
+
+    /** @brief start reading
+        @param tuple with the columns selected
+        @param first the first row
+        @param last one past the last row: the end of the tuple if greater
+        @param block_size [0] rows in a block, zero for s_block_size
+        @param depth [0] number of blocks in the ring, zero for s_depth
+        @param ahead [true] read with a thread of its own; false to read each block in next
+    */
+    RootPrefetch(const RootTuple& tuple, size_t first, size_t last,
+        size_t block_size=0, unsigned int depth=0, bool ahead=true);
+
+    /// stop the reader, if there is one and it is not finished, and wait for it
+    ~RootPrefetch();
+
+    /** @brief the next block, valid until the following call
+        @return 0 when all the rows have been returned
+    */
+    const Block* next();
+
+    /// make ROOT safe to use from several threads, once: done before a reader thread is started
+    static void enableThreads();
+
+    static size_t s_block_size;  ///< default rows in a block, 4096
+    static unsigned int s_depth; ///< default blocks in the ring, 3: one in use, two read ahead
+
+private:
+    RootPrefetch(const RootPrefetch&);
+    RootPrefetch& operator=(const RootPrefetch&);
+
+    /// the reader thread
+    void read();
+
+    const RootTuple& m_tuple;
+    size_t m_first, m_last, m_block_size;
+    std::vector<Block> m_ring;
+    std::mutex m_mutex;              ///< protects the counts and flags
+    std::condition_variable m_filled, m_freed;
+    unsigned long m_read, m_used;    ///< blocks filled by the reader, and released by the caller
+    bool m_holding;                  ///< the caller has a block from next
+    bool m_done, m_stop;
+    std::exception_ptr m_error;
+    std::thread m_thread;            ///< last, started when the rest is set up, if reading ahead
+};
+
+#endif
@@ -61,7 +61,11 @@ public:
     ~RootTuple();
 
     /** @brief select a subset of columns for the Iterator
-        @param names vector of TLeaf names.
+        @param names vector of TLeaf names. A leaf may be named more than once: each gives a column.
+
+        If s_cache_size is not zero, each tree gets a TTreeCache of that size holding
+        only the branches of these columns, so that their baskets are read together.
+        If it is zero, the trees have no cache.
     */
     void selectColumns(const std::vector<std::string>& names, bool weighted);
 
@@ -80,6 +84,27 @@ public:
     */
     void fill_row(int event, std::vector<float>& row )const;
 
+    /** @brief fill columns from a range of rows
+        @param first the first row
+        @param count number of rows: fewer are read if the end is reached
+        @param columns one array for each selected column, in the order of the selectColumns list,
+        resized to the number of rows read
+        @return the number of rows read
+
+        Each column is read by its own branch, for the whole range. With ROOT 6.20 and later, a
+        branch holding single values of a basic type is read a basket at a time with the bulk API,
+        TBranch::GetBulkRead, and converted with no call per entry. Otherwise, or if a basket cannot
+        be read that way, each entry is read into a typed buffer bound with SetBranchAddress.
+        Leaves that are arrays, or of a type not known, are read with TLeaf::GetValue.
+        Throws std::runtime_error if a value is NaN or infinite, as fill_row.
+
+        With a cache, the range is read a cluster at a time, each loaded with TTree::LoadTree
+        first, since the cache fills from the entry loaded. The entry range of the cache runs
+        from the first row to the end. It is set again only if a block is outside it, so
+        reading blocks in order fills each cluster once.
+    */
+    size_t fill_block(size_t first, size_t count, std::vector<std::vector<float> >& columns)const;
+
     // forward declaration of nested class representing an entry
     class Entry;
 
@@ -128,6 +153,9 @@ public:
     size_t size()const;
     bool weighted()const{return m_weighted;}
 
+    /// size in bytes of the TTreeCache set up by selectColumns, 30 MB; zero for none
+    static long long s_cache_size;
+
 private:
     void add(std::string root_file, std::string tree_name);
   void add (TTree *t);
@@ -139,6 +167,7 @@ private:
     /// list of the selected entries associated with this tuple
     std::vector<EntryList> m_entries;
     int m_start, m_increment; ///> Increment to allow every-other
+    mutable size_t m_cache_first, m_cache_last; ///> rows in the entry range of the caches
     bool m_weighted;
 };
 #endif
@@ -0,0 +1,67 @@
+/** @file  ThreadPool.h
+    @brief declaration of class ThreadPool
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_ThreadPool_h
+#define classifier_ThreadPool_h
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+/** @class ThreadPool
+@brief A fixed set of worker threads, that run the numbered parts of a task.
+
+The threads are started once, and wait between calls to run. The thread calling run also
+does a share of the work, so a pool of one thread has no workers, and runs everything in
+the caller. Calls to run from several threads are serialized.
+*/
+class ThreadPool {
+public:
+    /// @class Task
+    /// @brief a job made of independent parts, numbered from 0
+    class Task {
+    public:
+        virtual void operator()(unsigned int part)const=0;
+        virtual ~Task(){}
+    };
+
+    /** @brief start the workers
+        @param nthreads [0] number of threads, including the caller; zero means one per core
+    */
+    explicit ThreadPool(unsigned int nthreads=0);
+    ~ThreadPool();
+
+    /** @brief run parts 0 to count-1 of the task, and return when all are done
+        If any part throws, the first exception is rethrown here, after the others finish.
+    */
+    void run(unsigned int count, const Task& task);
+
+    /// number of threads, including the caller
+    unsigned int size()const{return m_threads.size()+1;}
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    /// worker loop
+    void work();
+    /// take and run parts until there are none left. lock is held on entry and exit
+    void drain(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_run;             ///< held for the duration of a run
+    std::mutex m_mutex;           ///< protects the rest
+    std::condition_variable m_start, m_done;
+    const Task* m_task;
+    unsigned int m_count, m_next, m_pending;
+    unsigned long m_generation;   ///< incremented by each run, to wake the workers
+    bool m_stop;
+    std::exception_ptr m_error;
+};
+
+#endif
@@ -56,6 +56,9 @@ public:
      /// control boosting: set >0 for number of boosts
      static int s_boost; 
 
+     /// control variable screening: set >0 for the number of variables to train on, plus forced ones
+     static int s_screen;
+
 private:
     const TrainingInfo& m_info;
     std::ostream& log();
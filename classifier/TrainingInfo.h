@@ -32,6 +32,8 @@ public:
 
     const std::string& title()const{return m_title;}
     const StringList& vars()const{return m_vars;}
+    /// variables flagged "forced" in variables.txt: always kept by variable screening
+    const StringList& forcedVars()const{return m_forced;}
     const StringList& signalFiles()const{return m_signalFiles;}
     const StringList& backgroundFiles()const{return m_backgroundFiles;}
     const std::string& log()const{return m_log;}
@@ -42,11 +44,14 @@ public:
     std::string strip(std::string input);
       
     void parser(const std::string& input, std::vector<std::string>& output);
+    /// read names, one per line, from a file in the folder. Lines starting with '#' are comments,
+    /// '@' includes another file. A name may be followed by the flag "forced".
     void readnames(const std::string& filename, std::vector<std::string>& output);
 
 private:
     std::string m_title;
     StringList m_vars;
+    StringList m_forced;
     StringList m_signalFiles;
     StringList m_backgroundFiles;
     std::string m_log;
@@ -0,0 +1,94 @@
+/** @file  TreeExplainer.h
+    @brief declaration of class TreeExplainer
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_TreeExplainer_h
+#define classifier_TreeExplainer_h
+
+#include "classifier/CompiledTree.h"
+
+#include <vector>
+
+class DecisionTree;
+
+/** @class TreeExplainer
+@brief Variable importance and per-event attributions for an ensemble, from the training
+statistics of its nodes: see DecisionTree::addNode and Classifier::createTree.
+
+The importance of a variable is the gain of the branches that test it, summed over the nodes of
+each tree, and over the trees with the tree weights divided by their sum. For a single tree
+it is the same as Classifier::rateVariables.
+
+The attributions are SHAP values, computed by the TreeSHAP algorithm of Lundberg, Erion and Lee,
+in time proportional to the number of leaves times the square of the depth for each tree, rather
+than exponential in the number of variables. The expected value of a tree, given the values of a
+set of variables, follows a test on one of them, and averages the two children of a test on any
+other, weighted by their cover. The attribution of a variable is its Shapley value for this
+function, and the attributions add up to the value for the event minus the expected value over
+the training sample. Trees are combined as the evaluation does, weighted by the tree weight
+divided by the sum of weights.
+
+Filters are not explained: the attributions are of the weighted average of the other trees,
+which is the value for an event that passes the filters. For an event that a filter rejects, the
+value is 0, and the attributions and the expected value returned are all 0.
+*/
+class TreeExplainer {
+public:
+    /** @brief set up from a model, which is copied
+        Throws std::invalid_argument if the model does not have training statistics.
+    */
+    explicit TreeExplainer(const CompiledTree& model);
+    explicit TreeExplainer(const DecisionTree& dtree);
+
+    /** @brief the gain importance of each variable
+        @param ratings set to the importance, one for each variable up to the largest index used
+    */
+    void importance(std::vector<double>& ratings)const;
+
+    /// the expected value: the average over the training sample, as weighted by the cover
+    double expected()const{return m_expected;}
+
+    /** @brief attributions for one event
+        @param row the values, indexed by variable
+        @param phi output: width() values, the attribution of each variable
+        @return the expected value. It plus the sum of phi is the value of the model for the event
+    */
+    double explain(const float* row, double* phi)const;
+
+    /** @brief attributions for a block of events
+        @param rows row-major matrix: variable j of event i is rows[i*stride+j]
+        @param count number of events
+        @param stride distance between rows
+        @param phi output: for each event, width()+1 values, the attributions then the expected value
+        @param nthreads [1] number of threads; zero means one per core
+    */
+    void explain(const float* rows, size_t count, size_t stride, double* phi, unsigned int nthreads=1)const;
+
+    /// number of variables: one more than the largest index used
+    int width()const{return m_model.width();}
+
+private:
+    /// one step of the path of TreeSHAP: the variable, fractions of the paths taken, and weight
+    struct PathElement {
+        int index;
+        double zero_fraction, one_fraction, weight;
+    };
+
+    void setup();
+
+    /// add the attributions of one tree, times scale
+    void explainTree(unsigned int tree, const float* row, double scale, double* phi,
+        std::vector<PathElement>& paths)const;
+
+    void recurse(unsigned int tree, unsigned int position, const float* row, double scale, double* phi,
+        PathElement* parent_path, unsigned int depth, double zero_fraction, double one_fraction, int index)const;
+
+    CompiledTree m_model;
+    double m_sum_of_weights;   ///< of the trees that are not filters
+    double m_expected;
+    unsigned int m_depth;      ///< of the deepest tree
+};
+
+#endif
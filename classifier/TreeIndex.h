@@ -0,0 +1,109 @@
+/** @file  TreeIndex.h
+    @brief declaration of class TreeIndex
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_TreeIndex_h
+#define classifier_TreeIndex_h
+
+#include "classifier/CompiledTree.h"
+
+#include <string>
+#include <vector>
+
+/** @class TreeIndex
+@brief The position of each tree in a text file written by DecisionTree::print, so that some of
+the trees can be read without reading the others.
+
+The index is kept in a side file, the name of the text file with ".idx" appended. It is made
+the first time the text file is opened, by finding where each tree starts, and made again if
+the text file has changed: if its size, modification time, or a hash of its first and last 4096
+bytes, no longer match. If it cannot be written, it is made each time. It is written to a
+temporary file that is renamed into place, so that jobs opening the same model at the same time
+never read part of one. It is text: a header line,
+"DecisionTree index", the version, the size, time and hash of the text file and the number of
+trees; then for each tree, the position of its id 0 line, its line number and its weight.
+
+For example, for the first 10 trees of a boosted model, with any filters:
+@verbatim
+    TreeIndex index("dtree.txt");
+    DecisionTree dtree(index, index.select(10));
+@endverbatim
+*/
+class TreeIndex {
+public:
+    /// no file
+    TreeIndex(){}
+
+    /** @brief open the index of a text file, making it if needed
+        @param filename the text file
+
+        Throws std::runtime_error if the text file cannot be read, or has a format error
+        found while making the index.
+    */
+    explicit TreeIndex(const std::string& filename);
+
+    /// the text file
+    const std::string& filename()const{return m_filename;}
+    /// its first line
+    const std::string& title()const{return m_title;}
+    /// number of trees in the file
+    unsigned int treeCount()const{return m_trees.size();}
+    /// weight of tree i: not positive for a filter
+    double weight(unsigned int tree)const{return m_trees[tree].weight;}
+
+    /** @brief the trees needed for the evaluation with a tree limit, see DecisionTree::operator()
+        @param tree_count if nonzero, the number of trees that are not filters to keep, the first ones
+        @return the trees, in order: every filter, and the first tree_count of the others
+    */
+    std::vector<unsigned int> select(unsigned int tree_count)const;
+
+    /// only the filters
+    std::vector<unsigned int> filters()const;
+
+    /** @brief read some of the trees, replacing the contents of model
+        @param model the destination
+        @param trees the trees to read, in increasing order
+        @param nthreads [0] number of threads used to convert them, see TreeReader::read
+
+        Only the lines of these trees are read. Throws std::invalid_argument for a tree out of
+        range or out of order, std::runtime_error if the file does not match the index.
+    */
+    void read(CompiledTree& model, const std::vector<unsigned int>& trees, unsigned int nthreads=0)const;
+
+    /// name of the index file for a text file
+    static std::string indexName(const std::string& filename){return filename+".idx";}
+
+    /// version of the index format
+    static const int s_version = 2;
+
+private:
+    /// what identifies the contents of the text file
+    struct Stamp {
+        size_t size;
+        long long time;           ///< modification time
+        unsigned long long hash;  ///< of the first and last bytes
+    };
+
+    /// read the index file, false if missing or out of date
+    bool load(const Stamp& stamp);
+    /// make the index from the text file, and try to write it
+    void build(const Stamp& stamp);
+
+    /// where a tree is
+    struct Entry {
+        size_t offset; ///< position of the first line in the file
+        size_t line;   ///< its line number
+        double weight;
+    };
+
+    std::string m_filename;
+    std::string m_title;
+    size_t m_size;                ///< size of the text file
+    long long m_time;             ///< and the rest of its Stamp
+    unsigned long long m_hash;
+    std::vector<Entry> m_trees;
+};
+
+#endif
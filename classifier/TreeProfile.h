@@ -0,0 +1,118 @@
+/** @file  TreeProfile.h
+    @brief declaration of class TreeProfile
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_TreeProfile_h
+#define classifier_TreeProfile_h
+
+#include "classifier/CompiledTree.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+class DecisionTree;
+
+/** @class TreeProfile
+@brief Evaluate a DecisionTree while counting the visits to each node.
+
+This is a separate evaluation path, using CompiledTree::walk with a counting visitor:
+ordinary evaluation is not changed. The values returned are the same as DecisionTree.
+
+Each thread that evaluates counts into its own array, so there is no contention. A thread
+finds its arrays in a table of its own. Deleting a profile removes its entry from the table of
+the deleting thread; other threads remove it the next time they make an array, or when they
+end. The counts
+are added up by merge(), which should be called when no thread is evaluating; the other
+accessors return the totals as of the last merge. From the node counts follow the number of
+events reaching each tree, the mean depth of the leaf reached, and for filters, the fraction
+of the events reaching them that they reject.
+*/
+class TreeProfile {
+public:
+    /// copy the trees to profile
+    explicit TreeProfile(const DecisionTree& dtree);
+    ~TreeProfile();
+
+    /// evaluate one event, counting
+    template<class C>
+    double operator()(const C& values)const
+    {
+        Counters& c = counters();
+        ++c.events;
+        Counter count(&c.visits[0]);
+        return m_model.walk(values, count);
+    }
+
+    /// evaluate a block of events, stored as rows, counting
+    void evaluate(const float* rows, size_t count, size_t stride, double* scores)const;
+
+    /// add up the counts of all threads
+    void merge()const;
+    /// set all the counts to zero
+    void clear();
+
+    /// number of events evaluated
+    unsigned long long events()const{return m_events;}
+    /// visits to a node: position relative to the root, in the CompiledTree order
+    unsigned long long visits(unsigned int tree, unsigned int node)const
+    {
+        return m_visits[m_model.tree(tree).offset+node];
+    }
+    /// number of events reaching a tree
+    unsigned long long treeVisits(unsigned int tree)const{return visits(tree, 0);}
+    /// mean number of branch nodes passed on the way to a leaf
+    double depth(unsigned int tree)const;
+    /// for a filter, the fraction of events reaching it that it rejected
+    double rejection(unsigned int tree)const;
+
+    /** @brief print the trees as DecisionTree::print, with the visits to each node as a fourth
+        column, and the statistics of each tree after its weight. For reading, not for input.
+    */
+    void print(std::ostream& out=std::cout)const;
+
+    const CompiledTree& model()const{return m_model;}
+
+private:
+    TreeProfile(const TreeProfile&);
+    TreeProfile& operator=(const TreeProfile&);
+
+    /// counts of one thread
+    struct Counters {
+        std::vector<unsigned long long> visits;
+        unsigned long long events;
+    };
+    /// the visitor given to CompiledTree::walk
+    class Counter {
+    public:
+        Counter(unsigned long long* visits): m_visits(visits){}
+        void operator()(size_t node)const{ ++m_visits[node]; }
+    private:
+        unsigned long long* m_visits;
+    };
+
+    /// the counters of each profile used by a thread, by profile id
+    typedef std::map<unsigned long, Counters*> Table;
+
+    /// the table of the calling thread
+    static Table& table();
+
+    /// the counters of the calling thread, made on first use
+    Counters& counters()const;
+
+    void printNode(std::ostream& out, unsigned int tree, unsigned int node, long long id)const;
+
+    const CompiledTree m_model;
+    std::string m_title;
+    unsigned long m_id;                       ///< distinguishes this profile in the threads' tables
+    mutable std::mutex m_mutex;               ///< protects m_threads
+    mutable std::vector<Counters*> m_threads; ///< the counters of each thread
+    mutable std::vector<unsigned long long> m_visits; ///< totals, at the last merge
+    mutable unsigned long long m_events;
+};
+
+#endif
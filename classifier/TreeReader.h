@@ -0,0 +1,105 @@
+/** @file  TreeReader.h
+    @brief declaration of class TreeReader
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_TreeReader_h
+#define classifier_TreeReader_h
+
+#include "classifier/CompiledTree.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+/** @class TreeReader
+@brief Read the text format written by DecisionTree::print directly into a CompiledTree.
+
+The whole text is read into memory, and split into lines. The lines of each tree, starting
+with an id 0 line, are then converted in parallel: the numbers are scanned by hand, with
+strtod only for values that cannot be converted exactly by a single multiplication or
+division, so the values are the same as with operator>>. Each node is placed by its id, through
+a table of the ids of its tree, so reading is linear in the number of nodes, and no node is
+allocated separately.
+
+A node line may also have the cover and gain of the node, see DecisionTree::print, which are
+then kept in the CompiledTree. A tree with several outputs has their number on its id 0 line,
+and each leaf line has them after the value; all the trees that are not filters must have the
+same number.
+
+The format is checked: a line that does not have three or five numbers, besides the outputs, an id repeated, a node
+without a parent, or a branch without both children, is reported with its line number as a
+std::runtime_error. Lines with a negative id are ignored; a root node, id 1, before any id 0
+line starts a tree of weight 1. Both as the DecisionTree constructor.
+*/
+class TreeReader {
+public:
+    /** @brief read the text, and find the trees
+        @param in the stream, positioned at the title line
+    */
+    explicit TreeReader(std::istream& in);
+
+    /// start empty, for parts of a file added by append
+    explicit TreeReader(const std::string& title);
+
+    /** @brief add part of a file, whole trees only
+        @param text the lines, starting with the id 0 line of a tree
+        @param line the line number of the first of them in the file, for error messages
+        @return the number of trees found
+    */
+    unsigned int append(const std::string& text, size_t line);
+
+    /// the first line
+    const std::string& title()const{return m_title;}
+
+    /// number of trees
+    unsigned int treeCount()const{return m_trees.size();}
+    /// weight of tree i
+    double weight(unsigned int tree)const{return m_trees[tree].weight;}
+    /// number of outputs of tree i
+    unsigned int outputs(unsigned int tree)const{return m_trees[tree].outputs;}
+    /// position of the first line of tree i, from the start of the text after the title
+    size_t offset(unsigned int tree)const;
+    /// line number of the first line of tree i
+    size_t line(unsigned int tree)const{return m_trees[tree].line;}
+    /// length of the text after the title
+    size_t size()const{return m_text.size();}
+
+    /** @brief convert the trees, replacing the contents of model
+        @param model the destination
+        @param nthreads [0] number of threads; zero means one per core
+    */
+    void read(CompiledTree& model, unsigned int nthreads=0)const;
+
+    /** @brief convert one tree
+        @param tree which
+        @param weight its weight
+        @param nodes the nodes, root first, as DecisionTree::compile would lay them out
+        @param statistics the cover and gain of each node, or empty if none of its lines has them
+        @param values the outputs of the leaves, if more than one, with each leaf's child the
+        position of its outputs
+    */
+    void readTree(unsigned int tree, double& weight, std::vector<CompiledTree::Node>& nodes,
+        std::vector<CompiledTree::Statistics>& statistics, std::vector<double>& values)const;
+
+private:
+    /// a tree: its weight, and its lines
+    struct Tree {
+        double weight;
+        unsigned int outputs; ///< number of outputs of each leaf
+        size_t start;      ///< the id 0 line, or the root if there is none, in m_lines
+        size_t first, end; ///< range of the node lines in m_lines
+        size_t line;       ///< line number of start
+    };
+
+    /// find the lines and trees in m_text from pos, where the line number is number
+    void split(size_t pos, size_t number);
+
+    std::string m_text;
+    std::string m_title;
+    std::vector<size_t> m_lines; ///< start of each line after the title, in m_text
+    std::vector<Tree> m_trees;
+};
+
+#endif
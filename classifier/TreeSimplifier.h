@@ -0,0 +1,108 @@
+/** @file  TreeSimplifier.h
+    @brief declaration of class TreeSimplifier
+
+    $Header$
+*/
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifndef classifier_TreeSimplifier_h
+#define classifier_TreeSimplifier_h
+
+#include "classifier/CompiledTree.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/** @class TreeSimplifier
+@brief Remove the nodes of an ensemble that cannot change its value.
+
+- A test whose outcome is decided, for every event that can reach it, is replaced by the child
+taken. The range of each variable is narrowed by the cuts of the ancestors of a node, and for
+the trees that are not filters, by the filters: the value of those trees matters only for events
+that pass every filter, which lie inside the smallest box around the leaves with value 1.
+- A branch whose two children are the same, for example two leaves of equal value, is replaced
+by the child, so a subtree with all leaves equal becomes one leaf.
+- A filter that is the same as an earlier one, leaf values included, is dropped.
+
+An event with a NaN value goes right at every test, as in CompiledTree, and this is allowed
+for: the range of a variable includes NaN until a left branch has been taken on it. So the
+value of the result is exactly that of the original, for every event.
+
+Optionally, trees that are not filters, and have the same tests, are merged: the first gets the
+sum of their weights and, at each leaf, the weighted mean of their values. The result is then
+the same only up to rounding, since the weighted sum is regrouped, and tree_count limits refer to
+the merged trees. It is not done by default.
+
+The layout of each tree, hot children first, is kept, and the training statistics if any: the
+node that replaces a branch takes its cover, so that the covers of two children still add up
+to that of their parent. With merging, the statistics of a merged tree are those of the first.
+
+Trees with several outputs, see CompiledTree::outputs, are not simplified: the constructor throws
+std::invalid_argument.
+*/
+class TreeSimplifier {
+public:
+    /** @brief simplify
+        @param model the trees
+        @param merge [false] also merge trees with the same tests
+    */
+    explicit TreeSimplifier(const CompiledTree& model, bool merge=false);
+
+    /// the simplified trees
+    const CompiledTree& model()const{return m_model;}
+
+    /// number of tests removed because their outcome was decided
+    unsigned int decided()const{return m_decided;}
+    /// number of branches replaced by one of two equal children
+    unsigned int collapsed()const{return m_collapsed;}
+    /// number of trees dropped or merged into another
+    unsigned int merged()const{return m_merged;}
+
+    /// summary of the nodes removed
+    void print(std::ostream& out=std::cout)const;
+
+private:
+    /// a node of a tree being simplified
+    struct Node {
+        double value;
+        int index;        ///< -1 for a leaf
+        int left, right;  ///< positions of the children in the tree
+        bool right_first; ///< lay out the right subtree first
+        CompiledTree::Statistics statistics;
+    };
+    typedef std::vector<Node> Tree;
+
+    /// the range of each variable: low <= x < high, or NaN if nan
+    struct Box {
+        std::vector<double> low, high;
+        std::vector<bool> nan;
+    };
+
+    /// simplify the subtree of the original at position, return its position in out
+    int simplify(const CompiledTree::Node* root, const CompiledTree::Statistics* statistics,
+        unsigned int position, Box& box, Tree& out);
+
+    /// extend the box hull around the leaves of the original with value 1
+    void passing(const CompiledTree::Node* root, unsigned int position, Box& box, Box& hull, bool& any)const;
+
+    /// the same subtrees, including the leaf values
+    static bool same(const Tree& a, int i, const Tree& b, int j);
+    /// append to out a key for the tests of a subtree, and its leaf values if values
+    static void key(const Tree& tree, int i, bool values, std::string& out);
+    /// add weight times the leaf values of b to those of a, which has the same tests
+    static void addLeaves(Tree& a, int i, const Tree& b, int j, double weight);
+    /// multiply the leaf values
+    static void multiplyLeaves(Tree& a, int i, double factor);
+    /// divide the leaf values
+    static void divideLeaves(Tree& a, int i, double divisor);
+    /// lay out a subtree as DecisionTree::compile does
+    static void place(const Tree& tree, int i, std::vector<CompiledTree::Node>& nodes,
+        std::vector<CompiledTree::Statistics>* statistics, unsigned int position);
+
+    CompiledTree m_model;
+    size_t m_before;        ///< number of nodes in the original
+    unsigned int m_trees_before;
+    unsigned int m_decided, m_collapsed, m_merged;
+};
+
+#endif
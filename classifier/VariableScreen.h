@@ -0,0 +1,71 @@
+/** @file VariableScreen.h
+@brief declaration of the class VariableScreen
+
+$Header$
+*/
+#ifndef classifier_VariableScreen_h
+#define classifier_VariableScreen_h
+
+#include "classifier/Classifier.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+/** @class VariableScreen
+@brief Rate each column of a training table by itself, before training, and choose a subset.
+
+Each variable is rated by the best Gini improvement of a single cut on the full sample,
+the same quantity that Classifier::Node::split minimizes. Since the rating of one variable
+does not depend on the others, the columns are rated in parallel.
+
+The selection keeps the best rated variables, up to a maximum number, but skips any that
+are almost duplicates (correlation above a threshold) of one already selected. Forced
+variables are always kept. The result is a list of column indices suitable for
+Classifier::Node::setActive.
+
+*/
+class VariableScreen {
+public:
+    /** @brief rate all the columns of the table
+    @param data the training sample
+    @param nthreads [0] number of threads to use; zero means one per core
+    */
+    VariableScreen(const Classifier::Table& data, int nthreads=0);
+
+    /** @brief choose the variables to use for training
+    @param keep maximum number of variables to keep, not counting forced ones
+    @param forced names of variables to keep in any case
+    @param max_correlation two variables with a larger absolute correlation are considered duplicates
+    @return the indices of the selected columns, in column order
+    */
+    const std::vector<int>& select(unsigned int keep,
+        const std::vector<std::string>& forced=std::vector<std::string>(),
+        double max_correlation=0.98);
+
+    /// the selected column indices: all columns if select has not been called
+    const std::vector<int>& selected()const{return m_selected;}
+
+    /// the Gini improvement of the best single cut for column i
+    double rating(int i)const{return m_ratings[i];}
+
+    /// print the rating of each variable, and the reason for those dropped
+    void print(std::ostream& log=std::cout)const;
+
+    /// maximum number of records used to estimate correlations
+    static unsigned int s_correlation_sample;
+
+private:
+    /// correlation of columns i and j, from the standardized sample
+    double correlation(int i, int j)const;
+
+    int m_nvar;
+    std::vector<double> m_ratings;    ///< best single-cut improvement, per column
+    std::vector<double> m_cuts;       ///< value for the best cut, per column
+    std::vector<std::vector<float> > m_sample; ///< standardized columns, for correlation
+    std::vector<double> m_sample_weights;
+    std::vector<int> m_selected;
+    std::vector<std::string> m_status; ///< reason for keeping or dropping, per column
+};
+
+#endif
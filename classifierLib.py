@@ -6,6 +6,8 @@ def generate(env, **kw):
             env.Tool('findPkgPath', package = 'classifier') 
     env.Tool('addLibrary', library = env['clhepLibs'])
     env.Tool('addLibrary', library = env['rootLibs'])
+    if env['PLATFORM'] != "win32":
+        env.Tool('addLibrary', library = ['dl'])  # for GeneratedTree
     # no need for incsOnly section since classifier doesn't reference
     # other packages
 def exists(env):
@@ -9,6 +9,8 @@ $Header: /nfs/slac/g/glast/ground/cvs/classifier/src/BackgroundVsEfficiency.cpp,
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 //  bin size, assuming 0-1 range.
 double BackgroundVsEfficiency::s_binsize=0.01;
@@ -58,10 +60,24 @@ BackgroundVsEfficiency::BackgroundVsEfficiency(
 : m_total_bkg(0)
 , m_total_sig(0)
 {
-    for( Classifier::Table::const_iterator i=data.begin(); i!=data.end(); ++i)  {
-        const Classifier::Record& r = *i;
-        double purity = dtree(r,max_tree); // the predicted purity using the decision tree
-        add(purity, r.weight(true), r.weight(false));
+    // copy blocks of records into a matrix, to evaluate the trees a block at a time
+    const size_t block = CompiledTree::s_block;
+    size_t width = data.empty()? 0 : data.front().size();
+    if( !data.empty() && static_cast<int>(width) < dtree.compiled().width() ){
+        throw std::invalid_argument("BackgroundVsEfficiency: records have fewer variables than the trees use");
+    }
+    std::vector<float> rows(block*width);
+    std::vector<double> purity(block); // the predicted purity using the decision tree
+    for( size_t first=0; first<data.size(); first+=block) {
+        size_t count = std::min(block, data.size()-first);
+        for( size_t k=0; k<count; ++k){
+            std::copy(data[first+k].begin(), data[first+k].end(), rows.begin()+k*width);
+        }
+        dtree.evaluate(rows.empty()? 0 : &rows[0], count, width, &purity[0], max_tree);
+        for( size_t k=0; k<count; ++k){
+            const Classifier::Record& r = data[first+k];
+            add(purity[k], r.weight(true), r.weight(false));
+        }
     }
     setup();
 }
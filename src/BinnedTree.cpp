@@ -0,0 +1,140 @@
+/** @file  BinnedTree.cpp
+    @brief implementation of class BinnedTree
+
+    $Header$
+*/
+#include "classifier/BinnedTree.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+const BinnedTree::Bin BinnedTree::s_leaf;
+
+BinnedTree::BinnedTree(const CompiledTree& model)
+: m_cuts(model.width())
+{
+    // collect the distinct cuts for each variable
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        const CompiledTree::Node* root = model.root(tree);
+        for( size_t k=0; k<model.treeSize(tree); ++k){
+            if( !root[k].isLeaf() ) m_cuts[root[k].index].push_back(root[k].value);
+        }
+    }
+    for( int i=0; i<width(); ++i){
+        std::vector<double>& cuts = m_cuts[i];
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+        if( cuts.size() >= s_leaf ) {
+            throw std::invalid_argument("BinnedTree: too many distinct cuts for a variable");
+        }
+        if( !cuts.empty()) m_used.push_back(i);
+    }
+    if( width() > s_leaf ) throw std::invalid_argument("BinnedTree: too many variables");
+
+    // the same layout, with each cut replaced by one more than its rank
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        const CompiledTree::Node* root = model.root(tree);
+        m_offsets.push_back(m_nodes.size());
+        m_weights.push_back(model.tree(tree).weight);
+        for( size_t k=0; k<model.treeSize(tree); ++k){
+            const CompiledTree::Node& n = root[k];
+            Node b;
+            if( n.isLeaf() ){
+                b.feature = s_leaf;
+                b.cut = 0;
+                b.child = m_leaves.size();
+                m_leaves.push_back(n.value);
+            }else{
+                const std::vector<double>& cuts = m_cuts[n.index];
+                b.feature = n.index;
+                b.cut = std::lower_bound(cuts.begin(), cuts.end(), n.value) - cuts.begin() + 1;
+                b.child = n.child;
+            }
+            m_nodes.push_back(b);
+        }
+    }
+}
+
+void BinnedTree::bin(const float* row, Bin* bins)const
+{
+    for( std::vector<int>::const_iterator it=m_used.begin(); it!=m_used.end(); ++it){
+        const std::vector<double>& cuts = m_cuts[*it];
+        double x = row[*it];
+        // the number of cuts <= x: a NaN compares false, and gets them all
+        bins[*it] = std::upper_bound(cuts.begin(), cuts.end(), x) - cuts.begin();
+    }
+}
+
+double BinnedTree::score(const Bin* bins)const
+{
+    double weighted_sum=0, sum_of_weights=0;
+    for( unsigned int tree=0; tree<m_weights.size(); ++tree){
+        double weight = m_weights[tree];
+        double value = evaluate(tree, bins);
+        if( weight <= 0 ){
+            if( value == 0 ) return 0;
+            if( value != 1.0 ) {
+                throw std::runtime_error(
+                    "BinnedTree: processing a filter, expect only 0 or 1 leaf nodes");
+            }
+            continue;
+        }
+        sum_of_weights += weight;
+        weighted_sum += weight * value;
+    }
+    return sum_of_weights != 0 ? weighted_sum/sum_of_weights : 1;
+}
+
+double BinnedTree::operator()(const float* row)const
+{
+    // on the stack, unless there are too many variables: no allocation for each event
+    const size_t local = 256;
+    if( static_cast<size_t>(width()) < local ){
+        Bin bins[local];
+        bin(row, bins);
+        return score(bins);
+    }
+    std::vector<Bin> bins(width()+1);
+    bin(row, &bins[0]);
+    return score(&bins[0]);
+}
+
+void BinnedTree::evaluate(const float* rows, size_t count, size_t stride, double* scores)const
+{
+    const size_t block = CompiledTree::s_block, w = width()+1;
+    std::vector<Bin> bins(block*w);
+    std::vector<bool> alive(block);
+    for( size_t first=0; first<count; first+=block){
+        size_t n = std::min(block, count-first);
+        double* sums = scores+first;
+        for( size_t i=0; i<n; ++i){
+            bin(rows+(first+i)*stride, &bins[i*w]);
+            alive[i]=true;
+            sums[i]=0;
+        }
+        // filters first, then the weighted sum in tree order, as CompiledTree does
+        double sum_of_weights=0;
+        for( unsigned int tree=0; tree<m_weights.size(); ++tree){
+            if( m_weights[tree] > 0 ) { sum_of_weights += m_weights[tree]; continue; }
+            for( size_t i=0; i<n; ++i){
+                if( !alive[i] ) continue;
+                double value = evaluate(tree, &bins[i*w]);
+                if( value == 0 ) alive[i]=false;
+                else if( value != 1.0 ) {
+                    throw std::runtime_error(
+                        "BinnedTree: processing a filter, expect only 0 or 1 leaf nodes");
+                }
+            }
+        }
+        for( unsigned int tree=0; tree<m_weights.size(); ++tree){
+            double weight = m_weights[tree];
+            if( weight <= 0 ) continue;
+            for( size_t i=0; i<n; ++i){
+                if( alive[i] ) sums[i] += weight * evaluate(tree, &bins[i*w]);
+            }
+        }
+        for( size_t i=0; i<n; ++i){
+            sums[i] = !alive[i] ? 0 : sum_of_weights != 0 ? sums[i]/sum_of_weights : 1;
+        }
+    }
+}
@@ -19,6 +19,7 @@ $Header: /nfs/slac/g/glast/ground/cvs/classifier/src/Classifier.cpp,v 1.5 2005/1
 #define absolute_minimum
 int Classifier::Record::s_sort_column=0;
 int Classifier::Record::s_size=0;
+int Classifier::Record::s_classes=0;
 std::vector<std::string> Classifier::Record::s_column_names;
 bool Classifier::Record::s_use_weights=false;
 
@@ -43,6 +44,7 @@ namespace {
 int Classifier::Node::s_nodes=0;
 int Classifier::Node::s_leaves=0;
 double Classifier::Node::s_improvement_minimum=0;
+std::vector<int> Classifier::Node::s_active;
 // select the criterion
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 /**  @class Gini  
@@ -78,6 +80,13 @@ const Classifier::SplitCriterion& splitCriterion = Gini();
 //const Classifier::SplitCriterion& splitCriterion = Entropy();
 
 namespace {
+    /// the Gini criterion for several classes, the same as Gini for two: (W^2 - sum of w^2)/W
+    double classGini(const double* weights, int classes)
+    {
+        double total=0, squares=0;
+        for( int k=0; k<classes; ++k){ total += weights[k]; squares += weights[k]*weights[k]; }
+        return total>0? (total*total-squares)/total : 0;
+    }
 
     std::ostream* thelog = &std::cout;
     std::ostream & logstream(){ return  *thelog ;}
@@ -102,6 +111,7 @@ Classifier::Record::Record( bool signal, const std::vector<float>& data)
     
     m_sigwt = signal? wt : 0;
     m_bkgwt = signal? 0 : wt;
+    m_category = signal? 1 : 0;
     int size = data.end()-id; // should be current size
     if( s_size==0)   s_size = size;
     if (size != s_size) throw std::invalid_argument("Record::Record: size of data record changed!");
@@ -116,12 +126,22 @@ Classifier::Record::Record( bool signal, std::vector<float>::const_iterator id,
    
     m_sigwt = signal? wt : 0;
     m_bkgwt = signal? 0 : wt;
+    m_category = signal? 1 : 0;
     int size = end-id; // should be current size
     if( s_size==0)   s_size = size;
     if (size != s_size) throw std::invalid_argument("Record::Record: size of data record changed!");
     for(; id!=end; ++id) push_back(*id);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void Classifier::Record::setCategory(int category)
+{
+    if( category<0 || (s_classes>1 && category>=s_classes) ) {
+        throw std::invalid_argument("Record::setCategory: class out of range");
+    }
+    m_category = category;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 void Classifier::Table::normalize(double signal, double background)
 {
@@ -157,6 +177,15 @@ Classifier::Node::Node(Table::iterator begin, Table::iterator end, Identifier_t
     m_signal = totsig;
     m_background = totbkg;
     m_gini = splitCriterion(totsig,totbkg);
+    int classes = Record::classes();
+    if( classes>1 ){
+        m_class_weights.assign(classes, 0.);
+        for( Table::iterator i=begin; i!=end; ++i){
+            if( i->category()>=classes ) throw std::invalid_argument("Classifier::Node: record class out of range");
+            m_class_weights[i->category()] += i->weight();
+        }
+        m_gini = classGini(&m_class_weights[0], classes);
+    }
 #ifdef verbose
     logstream() << "Created node "<< id << " with " << size() <<" records" <<std::endl;
 #endif
@@ -234,7 +263,28 @@ double Classifier::Node::sort(int sort_column)
     // after sorting, set the gini.
     m_signal = lastsig;
     m_background = lastbkg;
-    return m_gini = splitCriterion(lastsig, lastbkg);
+    int classes = m_class_weights.size();
+    if( classes==0 ) return m_gini = splitCriterion(lastsig, lastbkg);
+
+    // several classes: the cumulative weight of each, for gini(rec)
+    m_cumulative.assign(size()*classes, 0.);
+    std::vector<double> sums(classes, 0.);
+    double* cum = m_cumulative.empty()? 0 : &m_cumulative[0];
+    for( Table::iterator i=begin(); i!=end(); ++i, cum+=classes){
+        sums[i->category()] += i->weight();
+        std::copy(sums.begin(), sums.end(), cum);
+    }
+    return m_gini = classGini(&m_class_weights[0], classes);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+std::vector<double> Classifier::Node::purities()const
+{
+    double total=0;
+    for( size_t k=0; k<m_class_weights.size(); ++k) total += m_class_weights[k];
+    std::vector<double> result(m_class_weights.size(), 0.);
+    for( size_t k=0; k<result.size() && total>0; ++k) result[k] = m_class_weights[k]/total;
+    return result;
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -296,6 +346,19 @@ double Classifier::Node::minimize_gini()
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 double Classifier::Node::gini(const Record& rec )const
 {
+    int classes = m_class_weights.size();
+    if( classes>0 ){
+        // the records up to this one, in sorted order, go left
+        const double* left = &m_cumulative[(&rec - &*m_begin)*classes];
+        double wleft=0, sqleft=0, wright=0, sqright=0;
+        for( int k=0; k<classes; ++k){
+            double right = m_class_weights[k]-left[k];
+            wleft += left[k]; sqleft += left[k]*left[k];
+            wright += right;  sqright += right*right;
+        }
+        if( wleft==0 || wright==0 ) return m_gini; // should prevent being considered
+        return (wleft*wleft-sqleft)/wleft + (wright*wright-sqright)/wright;
+    }
     double 
         sig_l = rec.cum_weight(true),
         sig_r = m_signal-sig_l,
@@ -330,7 +393,9 @@ void Classifier::Node::split( bool recursive)
     logstream() << "Splitting node " << id() 
         << "\n    index   improvement   at value" << std::endl;
 #endif
-    for(int n=0 ; n<nvar ; ++n){
+    int ncol = s_active.empty()? nvar : s_active.size();
+    for(int k=0 ; k<ncol ; ++k){
+        int n = s_active.empty()? k : s_active[k];
         double gtot=sort(n);
         double x = minimize_gini();
         double gx = gini(x);
@@ -353,6 +418,7 @@ void Classifier::Node::split( bool recursive)
             << std::setw(10) << std::left << xbest << std::endl;
 #endif
      Table::iterator split_at = lower_bound(xbest);
+     std::vector<double>().swap(m_cumulative); // only needed to find the split
 
     // if if either child is too small this is a leaf node
     // also can't go beyond 31 in depth with ints as ids, or 63 with long long
@@ -592,8 +658,14 @@ DecisionTree* Classifier::createTree(std::string title, double weight)
 	}
         void visit(const Node& node)
         {
-            if( node.isLeaf() )     m_dtree->addNode(node.id(), -1, node.purity());
-            else m_dtree->addNode(node.id(), node.index(), node.value());
+            // with the weight and the gini improvement, as rateVariables, for TreeExplainer
+            // with several classes, the purity of each, for DecisionTree::evaluateAll
+            if( node.isLeaf() && Record::classes()>1 ) {
+                m_dtree->addLeaf(node.id(), node.purity(), node.purities(), node.totalWeight());
+            }
+            else if( node.isLeaf() ) m_dtree->addNode(node.id(), -1, node.purity(), node.totalWeight(), 0);
+            else m_dtree->addNode(node.id(), node.index(), node.value(),
+                node.totalWeight(), node.total_gini() - node.split_gini());
         }
         DecisionTree* m_dtree;
     };
@@ -0,0 +1,407 @@
+/** @file  CompiledTree.cpp
+    @brief implementation of class CompiledTree
+
+    $Header$
+*/
+#include "classifier/CompiledTree.h"
+
+#include <algorithm>
+
+namespace {
+    /// access to a row-major matrix: event i is a pointer, indexed by variable
+    class RowMatrix {
+    public:
+        RowMatrix(const float* rows, size_t stride): m_rows(rows), m_stride(stride){}
+        const float* operator[](size_t i)const{return m_rows+i*m_stride;}
+        size_t stride()const{return m_stride;}
+    private:
+        const float* m_rows;
+        size_t m_stride;
+    };
+
+    /// access to a set of columns: event i is a proxy, indexed by variable
+    class ColumnMatrix {
+    public:
+        class Row {
+        public:
+            Row(const float* const* columns, size_t i): m_columns(columns), m_i(i){}
+            float operator[](int j)const{return m_columns[j][m_i];}
+        private:
+            const float* const* m_columns;
+            size_t m_i;
+        };
+        ColumnMatrix(const float* const* columns): m_columns(columns){}
+        Row operator[](size_t i)const{return Row(m_columns, i);}
+    private:
+        const float* const* m_columns;
+    };
+
+    /// the events of a block that pass the filters, evaluated one at a time
+    template<class Rows>
+    class Survivors {
+    public:
+        Survivors(const CompiledTree& model, const Rows& rows): m_model(model), m_rows(rows){}
+        /// use events first+live[k], for k from 0 to count-1
+        void select(size_t first, const unsigned int* live, size_t count, bool /*all*/)
+        {
+            m_first=first; m_live=live; m_count=count;
+        }
+        void leaves(unsigned int tree, double* out)const
+        {
+            for( size_t k=0; k<m_count; ++k) out[k] = m_model.evaluate(tree, m_rows[m_first+m_live[k]]);
+        }
+    private:
+        const CompiledTree& m_model;
+        const Rows& m_rows;
+        size_t m_first;
+        const unsigned int* m_live;
+        size_t m_count;
+    };
+
+    /// rows are contiguous: use the lockstep kernel, on a copy of the survivors if some failed
+    template<>
+    class Survivors<RowMatrix> {
+    public:
+        Survivors(const CompiledTree& model, const RowMatrix& rows)
+            : m_model(model), m_rows(rows), m_width(std::max(model.width(), 1)){}
+        void select(size_t first, const unsigned int* live, size_t count, bool all)
+        {
+            m_count = count;
+            if( all ){
+                m_data = m_rows[first];
+                m_stride = m_rows.stride();
+                return;
+            }
+            m_buffer.resize(count*m_width);
+            for( size_t k=0; k<count; ++k){
+                const float* row = m_rows[first+live[k]];
+                std::copy(row, row+m_width, &m_buffer[k*m_width]);
+            }
+            m_data = m_buffer.empty()? 0 : &m_buffer[0];
+            m_stride = m_width;
+        }
+        void leaves(unsigned int tree, double* out)const
+        {
+            CompiledTree::selectLeaves(m_model.root(tree), m_data, m_stride, m_count, out);
+        }
+    private:
+        const CompiledTree& m_model;
+        const RowMatrix& m_rows;
+        size_t m_width;
+        std::vector<float> m_buffer;
+        const float* m_data;
+        size_t m_stride, m_count;
+    };
+}
+
+const unsigned int CompiledTree::s_block;
+double CompiledTree::s_margin = 1e-9;
+
+CompiledTree::CompiledTree(const CompiledTree& other)
+{
+    *this = other;
+}
+
+CompiledTree& CompiledTree::operator=(const CompiledTree& other)
+{
+    if( this==&other ) return *this;
+    m_nodes.assign(other.m_data, other.m_data+other.m_size);
+    m_data = m_nodes.empty()? 0 : &m_nodes[0];
+    m_size = other.m_size;
+    m_trees = other.m_trees;
+    m_statistics = other.m_statistics;
+    m_outputs = other.m_outputs;
+    m_value_data.assign(other.m_values, other.m_values+other.m_value_count);
+    m_values = m_value_data.empty()? 0 : &m_value_data[0];
+    m_value_count = other.m_value_count;
+    m_width = other.m_width;
+    m_total_weight = other.m_total_weight;
+    m_low = other.m_low;
+    m_high = other.m_high;
+    m_order = other.m_order;
+    m_rest_low = other.m_rest_low;
+    m_rest_high = other.m_rest_high;
+    return *this;
+}
+
+void CompiledTree::addTree(double weight, const std::vector<Node>& nodes, const std::vector<Statistics>& statistics)
+{
+    addOutputs(weight, 1);
+    append(weight, nodes, statistics);
+}
+
+void CompiledTree::append(double weight, const std::vector<Node>& nodes, const std::vector<Statistics>& statistics)
+{
+    if( nodes.empty()) throw std::invalid_argument("CompiledTree::addTree: tree has no nodes");
+    if( !statistics.empty() && statistics.size()!=nodes.size() ) {
+        throw std::invalid_argument("CompiledTree::addTree: statistics do not match the nodes");
+    }
+    if( m_data!=0 && m_nodes.empty() ) m_nodes.assign(m_data, m_data+m_size); // a view: copy it first
+    if( !statistics.empty() || !m_statistics.empty() ){
+        Statistics none = {0, 0};
+        m_statistics.resize(m_size, none);
+        if( statistics.empty() ) m_statistics.resize(m_size+nodes.size(), none);
+        else m_statistics.insert(m_statistics.end(), statistics.begin(), statistics.end());
+    }
+    Tree t;
+    t.weight = weight;
+    t.offset = m_size;
+    m_trees.push_back(t);
+    m_nodes.insert(m_nodes.end(), nodes.begin(), nodes.end());
+    m_data = &m_nodes[0];
+    m_size = m_nodes.size();
+    double low=0, high=0;
+    bool first=true;
+    for( std::vector<Node>::const_iterator it=nodes.begin(); it!=nodes.end(); ++it){
+        if( it->index >= m_width ) m_width = it->index+1;
+        if( !it->isLeaf() ) continue;
+        if( first || it->value < low) low=it->value;
+        if( first || it->value > high) high=it->value;
+        first=false;
+    }
+    m_low.push_back(low);
+    m_high.push_back(high);
+    setupOrder();
+}
+
+void CompiledTree::addTree(double weight, const std::vector<Node>& nodes, const std::vector<Statistics>& statistics,
+                           unsigned int outputs, const std::vector<double>& values)
+{
+    if( outputs==1 ) { addTree(weight, nodes, statistics); return; }
+    if( nodes.empty()) throw std::invalid_argument("CompiledTree::addTree: tree has no nodes");
+    if( weight <= 0 ) throw std::invalid_argument("CompiledTree::addTree: a filter has only one output");
+    std::vector<Tree> tree(1);
+    tree[0].weight = weight;
+    tree[0].offset = 0;
+    check(nodes.empty()? 0 : &nodes[0], nodes.size(), tree, outputs, values.size());
+    addOutputs(weight, outputs);
+
+    // the outputs go after those of the other trees
+    if( m_values!=0 && m_value_data.empty() ) m_value_data.assign(m_values, m_values+m_value_count);
+    std::vector<Node> moved(nodes);
+    for( std::vector<Node>::iterator it=moved.begin(); it!=moved.end(); ++it){
+        if( it->isLeaf() ) it->child += m_value_count;
+    }
+    m_value_data.insert(m_value_data.end(), values.begin(), values.end());
+    m_values = m_value_data.empty()? 0 : &m_value_data[0];
+    m_value_count = m_value_data.size();
+    append(weight, moved, statistics);
+}
+
+void CompiledTree::addOutputs(double weight, unsigned int outputs)
+{
+    if( weight <= 0 ) return; // filters have only one
+    bool first = true; // the first tree that is not a filter
+    for( unsigned int tree=0; tree<m_trees.size() && first; ++tree) first = m_trees[tree].weight <= 0;
+    if( !first && outputs!=m_outputs ) {
+        throw std::invalid_argument("CompiledTree::addTree: the number of outputs is not that of the other trees");
+    }
+    m_outputs = outputs;
+}
+
+void CompiledTree::view(const Node* nodes, size_t count, const std::vector<Tree>& trees)
+{
+    view(nodes, count, trees, 1, 0, 0);
+}
+
+void CompiledTree::view(const Node* nodes, size_t count, const std::vector<Tree>& trees,
+                        unsigned int outputs, const double* values, size_t value_count)
+{
+    check(nodes, count, trees, outputs, value_count);
+    m_nodes.clear();
+    m_statistics.clear();
+    m_value_data.clear();
+    m_outputs = outputs;
+    m_values = outputs>1? values : 0;
+    m_value_count = outputs>1? value_count : 0;
+    m_data = nodes;
+    m_size = count;
+    m_trees = trees;
+    setupTrees();
+}
+
+void CompiledTree::adopt(std::vector<Node>& nodes, const std::vector<Tree>& trees)
+{
+    std::vector<Statistics> none;
+    adopt(nodes, trees, none);
+}
+
+void CompiledTree::adopt(std::vector<Node>& nodes, const std::vector<Tree>& trees, std::vector<Statistics>& statistics)
+{
+    std::vector<double> none;
+    adopt(nodes, trees, statistics, 1, none);
+}
+
+void CompiledTree::adopt(std::vector<Node>& nodes, const std::vector<Tree>& trees, std::vector<Statistics>& statistics,
+                         unsigned int outputs, std::vector<double>& values)
+{
+    check(nodes.empty()? 0 : &nodes[0], nodes.size(), trees, outputs, values.size());
+    if( !statistics.empty() && statistics.size()!=nodes.size() ) {
+        throw std::invalid_argument("CompiledTree::adopt: statistics do not match the nodes");
+    }
+    m_statistics.swap(statistics);
+    statistics.clear();
+    m_outputs = outputs;
+    m_value_data.swap(values);
+    values.clear();
+    if( outputs==1 ) m_value_data.clear();
+    m_values = m_value_data.empty()? 0 : &m_value_data[0];
+    m_value_count = m_value_data.size();
+    m_nodes.swap(nodes);
+    nodes.clear();
+    m_data = m_nodes.empty()? 0 : &m_nodes[0];
+    m_size = m_nodes.size();
+    m_trees = trees;
+    setupTrees();
+}
+
+void CompiledTree::check(const Node* nodes, size_t count, const std::vector<Tree>& trees,
+                         unsigned int outputs, size_t value_count)
+{
+    if( outputs==0 ) throw std::invalid_argument("CompiledTree::view: no outputs");
+    for( unsigned int tree=0; tree<trees.size(); ++tree){
+        size_t end = tree+1<trees.size()? trees[tree+1].offset : count;
+        if( trees[tree].offset >= end || end > count ) {
+            throw std::invalid_argument("CompiledTree::view: bad tree position");
+        }
+        size_t size = end-trees[tree].offset;
+        for( size_t k=trees[tree].offset; k<end; ++k){
+            // the pair of children comes after the node, so that a walk always ends
+            size_t child = nodes[k].child, position = k-trees[tree].offset;
+            if( !nodes[k].isLeaf() && (child <= position || child >= size-1) ) {
+                throw std::invalid_argument("CompiledTree::view: child position out of range");
+            }
+            if( outputs>1 && trees[tree].weight > 0 && nodes[k].isLeaf()
+                && static_cast<size_t>(nodes[k].child)+outputs > value_count ) {
+                throw std::invalid_argument("CompiledTree::view: leaf outputs out of range");
+            }
+        }
+    }
+}
+
+void CompiledTree::setupTrees()
+{
+    m_width = 0;
+    m_low.assign(m_trees.size(), 0.);
+    m_high.assign(m_trees.size(), 0.);
+    for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+        const Node* node = root(tree);
+        bool first=true;
+        for( size_t k=0; k<treeSize(tree); ++k){
+            if( node[k].index >= m_width ) m_width = node[k].index+1;
+            if( !node[k].isLeaf() ) continue;
+            if( first || node[k].value < m_low[tree]) m_low[tree]=node[k].value;
+            if( first || node[k].value > m_high[tree]) m_high[tree]=node[k].value;
+            first=false;
+        }
+    }
+    setupOrder();
+}
+
+namespace {
+    /// order trees by decreasing weight times range of leaf values
+    class ByRange {
+    public:
+        ByRange(const std::vector<double>& range): m_range(range){}
+        bool operator()(unsigned int a, unsigned int b)const{return m_range[a] > m_range[b];}
+    private:
+        const std::vector<double>& m_range;
+    };
+}
+
+void CompiledTree::setupOrder()
+{
+    std::vector<double> range(m_trees.size());
+    m_order.clear();
+    m_total_weight = 0;
+    for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+        double weight = m_trees[tree].weight;
+        if( weight <= 0 ) continue;
+        range[tree] = weight*(m_high[tree]-m_low[tree]);
+        m_order.push_back(tree);
+        m_total_weight += weight;
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), ByRange(range));
+    m_rest_low.assign(m_order.size()+1, 0.);
+    m_rest_high.assign(m_order.size()+1, 0.);
+    for( unsigned int k=m_order.size(); k>0; --k){
+        unsigned int tree = m_order[k-1];
+        double weight = m_trees[tree].weight;
+        m_rest_low[k-1] = m_rest_low[k] + weight*m_low[tree];
+        m_rest_high[k-1] = m_rest_high[k] + weight*m_high[tree];
+    }
+}
+
+void CompiledTree::badFilter()
+{
+    throw std::runtime_error(
+        "CompiledTree::operator(): processing a filter, expect only 0 or 1 leaf nodes");
+}
+
+template<class Rows>
+void CompiledTree::evaluateBlock(const Rows& rows, size_t count, double* scores, unsigned int tree_count)const
+{
+    // the trees to use, and the sum of weights, the same for every event that passes the filters
+    std::vector<unsigned int> used;
+    double sum_of_weights=0;
+    for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+        if( m_trees[tree].weight <= 0 ) continue;
+        if( tree_count>0 && used.size()==tree_count ) break;
+        used.push_back(tree);
+        sum_of_weights += m_trees[tree].weight;
+    }
+    bool alive[s_block];
+    unsigned int live[s_block];
+    double leaves[s_block];
+    Survivors<Rows> survivors(*this, rows);
+    for( size_t first=0; first<count; first+=s_block){
+        size_t n = count-first < s_block ? count-first : s_block;
+        double* sums = scores+first;
+        for( size_t i=0; i<n; ++i){ alive[i]=true; sums[i]=0; }
+
+        // filters: an event failing one is not evaluated by any other tree
+        for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+            if( m_trees[tree].weight > 0 ) continue;
+            for( size_t i=0; i<n; ++i){
+                if( !alive[i] ) continue;
+                double value = evaluate(tree, rows[first+i]);
+                if( value == 0 ) alive[i]=false;
+                else if( value != 1.0 ) badFilter();
+            }
+        }
+        size_t m=0;
+        for( size_t i=0; i<n; ++i) if( alive[i] ) live[m++] = i;
+        if( m==0 ) continue;
+        survivors.select(first, live, m, m==n);
+
+        // the rest, for the survivors only: accumulate the weighted sum in tree order, as operator() does
+        for( unsigned int k=0; k<used.size(); ++k){
+            unsigned int tree = used[k];
+            double weight = m_trees[tree].weight;
+            survivors.leaves(tree, leaves);
+            for( size_t j=0; j<m; ++j) sums[live[j]] += weight * leaves[j];
+        }
+        for( size_t j=0; j<m; ++j){
+            double& sum = sums[live[j]];
+            sum = sum_of_weights != 0 ? sum/sum_of_weights : 1;
+        }
+    }
+}
+
+void CompiledTree::evaluate(const float* rows, size_t count, size_t stride, double* scores,
+                            unsigned int tree_count)const
+{
+    evaluateBlock(RowMatrix(rows, stride), count, scores, tree_count);
+}
+
+void CompiledTree::evaluate(const float* const* columns, size_t count, double* scores,
+                            unsigned int tree_count)const
+{
+    evaluateBlock(ColumnMatrix(columns), count, scores, tree_count);
+}
+
+void CompiledTree::evaluateAll(const float* rows, size_t count, size_t stride, double* result,
+                               unsigned int tree_count)const
+{
+    for( size_t i=0; i<count; ++i) evaluateAll(rows+i*stride, result+i*m_outputs, tree_count);
+}
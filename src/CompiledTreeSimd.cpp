@@ -0,0 +1,181 @@
+/** @file  CompiledTreeSimd.cpp
+    @brief implementation of CompiledTree::selectLeaves, with vector kernels chosen at run time
+
+    $Header$
+*/
+#include "classifier/CompiledTree.h"
+
+#include <algorithm>
+#include <climits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define CLASSIFIER_SIMD
+# include <immintrin.h>
+#endif
+
+namespace {
+
+    typedef void (*Kernel)(const CompiledTree::Node*, const float*, size_t, size_t, double*);
+
+    /// one event at a time: the reference
+    void scalar(const CompiledTree::Node* root, const float* rows, size_t stride, size_t count, double* leaves)
+    {
+        for( size_t i=0; i<count; ++i){
+            const float* row = rows+i*stride;
+            const CompiledTree::Node* node = root;
+            while( !node->isLeaf() ){
+                node = root + node->child + (row[node->index] < node->value ? 0 : 1);
+            }
+            leaves[i] = node->value;
+        }
+    }
+
+#ifdef CLASSIFIER_SIMD
+    // A Node is 16 bytes: the value is double 0, the index and child are int 2 and 3.
+    typedef char node_layout_check[sizeof(CompiledTree::Node)==16 ? 1 : -1];
+
+    // The gathers are all masked, from a zero source with every lane set, and the AVX-512
+    // extracts and conversions zero-masked: the unmasked forms start from an undefined
+    // vector, and GCC warns that it may be used uninitialized.
+
+    /// four doubles, at the given positions
+    __attribute__((target("avx2")))
+    inline __m256d gather(const double* base, __m128i position)
+    {
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, position,
+            _mm256_castsi256_pd(_mm256_set1_epi32(-1)), 8);
+    }
+
+    /// eight doubles, at the given positions
+    __attribute__((target("avx512f")))
+    inline __m512d gather(const double* base, __m256i position)
+    {
+        return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, position, base, 8);
+    }
+
+    /// eight events at a time, the doubles in two halves of four
+    __attribute__((target("avx2")))
+    void avx2(const CompiledTree::Node* root, const float* rows, size_t stride, size_t count, double* leaves)
+    {
+        const int* iroot = reinterpret_cast<const int*>(root);
+        const double* droot = reinterpret_cast<const double*>(root);
+        const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1), all = _mm256_set1_epi32(-1),
+            two = _mm256_set1_epi32(2), three = _mm256_set1_epi32(3),
+            lane = _mm256_setr_epi32(0,1,2,3,4,5,6,7),
+            bits = _mm256_setr_epi32(1,2,4,8,16,32,64,128);
+        size_t i=0;
+        for( ; i+8<=count; i+=8){
+            __m256i base = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(i), lane),
+                _mm256_set1_epi32(stride));
+            __m256i node = zero;
+            for(;;){
+                __m256i quad = _mm256_slli_epi32(node, 2);
+                __m256i index = _mm256_mask_i32gather_epi32(zero, iroot, _mm256_add_epi32(quad, two), all, 4);
+                __m256i leaf = _mm256_cmpgt_epi32(zero, index);
+                if( _mm256_movemask_ps(_mm256_castsi256_ps(leaf)) == 0xff ) break;
+
+                // lanes at a leaf read variable 0, and do not move
+                __m256 x = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), rows,
+                    _mm256_add_epi32(base, _mm256_max_epi32(index, zero)), _mm256_castsi256_ps(all), 4);
+                __m256i pair = _mm256_slli_epi32(node, 1);
+                __m256d cut_lo = gather(droot, _mm256_castsi256_si128(pair)),
+                    cut_hi = gather(droot, _mm256_extracti128_si256(pair, 1));
+                int less = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), cut_lo, _CMP_LT_OQ))
+                    | _mm256_movemask_pd(_mm256_cmp_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), cut_hi, _CMP_LT_OQ))<<4;
+                __m256i lessmask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(less), bits), bits);
+
+                // left child if less, else the one after it: lessmask is -1 or 0
+                __m256i child = _mm256_mask_i32gather_epi32(zero, iroot, _mm256_add_epi32(quad, three), all, 4);
+                __m256i next = _mm256_add_epi32(child, _mm256_add_epi32(one, lessmask));
+                node = _mm256_blendv_epi8(next, node, leaf);
+            }
+            __m256i pair = _mm256_slli_epi32(node, 1);
+            _mm256_storeu_pd(leaves+i,   gather(droot, _mm256_castsi256_si128(pair)));
+            _mm256_storeu_pd(leaves+i+4, gather(droot, _mm256_extracti128_si256(pair, 1)));
+        }
+        scalar(root, rows+i*stride, stride, count-i, leaves+i);
+    }
+
+    /// sixteen events at a time, the doubles in two halves of eight
+    __attribute__((target("avx512f")))
+    void avx512(const CompiledTree::Node* root, const float* rows, size_t stride, size_t count, double* leaves)
+    {
+        const int* iroot = reinterpret_cast<const int*>(root);
+        const double* droot = reinterpret_cast<const double*>(root);
+        const __m512i zero = _mm512_setzero_si512(), one = _mm512_set1_epi32(1),
+            two = _mm512_set1_epi32(2), three = _mm512_set1_epi32(3),
+            lane = _mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+        size_t i=0;
+        for( ; i+16<=count; i+=16){
+            __m512i base = _mm512_mullo_epi32(_mm512_add_epi32(_mm512_set1_epi32(i), lane),
+                _mm512_set1_epi32(stride));
+            __m512i node = zero;
+            for(;;){
+                __m512i pair = _mm512_add_epi32(node, node), quad = _mm512_add_epi32(pair, pair);
+                __m512i index = _mm512_mask_i32gather_epi32(zero, 0xffff, _mm512_add_epi32(quad, two), iroot, 4);
+                __mmask16 branch = _mm512_cmpge_epi32_mask(index, zero);
+                if( branch == 0 ) break;
+
+                // lanes at a leaf read nothing, and do not move
+                __m512 x = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), branch,
+                    _mm512_add_epi32(base, _mm512_maskz_mov_epi32(branch, index)), rows, 4);
+                __m512d cut_lo = gather(droot, _mm512_maskz_extracti64x4_epi64(0xf, pair, 0)),
+                    cut_hi = gather(droot, _mm512_maskz_extracti64x4_epi64(0xf, pair, 1));
+                __m512d x_lo = _mm512_maskz_cvtps_pd(0xff, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(x), 0))),
+                    x_hi = _mm512_maskz_cvtps_pd(0xff, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xf, _mm512_castps_pd(x), 1)));
+                __mmask16 less = _mm512_cmp_pd_mask(x_lo, cut_lo, _CMP_LT_OQ)
+                    | (_mm512_cmp_pd_mask(x_hi, cut_hi, _CMP_LT_OQ)<<8);
+
+                // left child if less, else the one after it
+                __m512i child = _mm512_mask_i32gather_epi32(zero, 0xffff, _mm512_add_epi32(quad, three), iroot, 4);
+                __m512i next = _mm512_mask_add_epi32(child, static_cast<__mmask16>(~less), child, one);
+                node = _mm512_mask_mov_epi32(node, branch, next);
+            }
+            __m512i pair = _mm512_add_epi32(node, node);
+            _mm512_storeu_pd(leaves+i,   gather(droot, _mm512_maskz_extracti64x4_epi64(0xf, pair, 0)));
+            _mm512_storeu_pd(leaves+i+8, gather(droot, _mm512_maskz_extracti64x4_epi64(0xf, pair, 1)));
+        }
+        scalar(root, rows+i*stride, stride, count-i, leaves+i);
+    }
+#endif
+
+    /// pick the best kernel that the processor supports
+    Kernel choose(const char*& name)
+    {
+#ifdef CLASSIFIER_SIMD
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx512f")) { name = "avx512"; return avx512; }
+        if( __builtin_cpu_supports("avx2"))    { name = "avx2";   return avx2; }
+#endif
+        name = "scalar";
+        return scalar;
+    }
+
+    const char* kernel_name = 0;
+    Kernel kernel()
+    {
+        static const Kernel k = choose(kernel_name);
+        return k;
+    }
+
+} // anon namespace
+
+bool CompiledTree::s_simd = true;
+
+void CompiledTree::selectLeaves(const Node* root, const float* rows, size_t stride, size_t count, double* leaves)
+{
+    // the kernels gather rows with 32-bit offsets: give them chunks whose offsets fit
+    size_t chunk = stride>0? static_cast<size_t>(INT_MAX)/stride : count;
+    if( !s_simd || chunk==0 ) { scalar(root, rows, stride, count, leaves); return; }
+    Kernel k = kernel();
+    for( size_t i=0; i<count; i+=chunk){
+        k(root, rows+i*stride, stride, std::min(chunk, count-i), leaves+i);
+    }
+}
+
+const char* CompiledTree::simdLevel()
+{
+    kernel(); // make sure it has been chosen
+    return s_simd ? kernel_name : "scalar";
+}
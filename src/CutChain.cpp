@@ -0,0 +1,180 @@
+/** @file  CutChain.cpp
+    @brief implementation of class CutChain
+
+    $Header$
+*/
+#include "classifier/CutChain.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define CLASSIFIER_SIMD
+# include <immintrin.h>
+#endif
+
+namespace {
+    typedef CutChain::Word Word;
+    typedef Word (*Kernel)(const float*, float);
+
+    /// bits for the 64 values less than the threshold
+    Word scalar(const float* x, float threshold)
+    {
+        Word bits=0;
+        for( unsigned int k=0; k<64; ++k) bits |= Word(x[k] < threshold) << k;
+        return bits;
+    }
+
+#ifdef CLASSIFIER_SIMD
+    __attribute__((target("avx2")))
+    Word avx2(const float* x, float threshold)
+    {
+        const __m256 t = _mm256_set1_ps(threshold);
+        Word bits=0;
+        for( unsigned int k=0; k<64; k+=8){
+            Word m = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x+k), t, _CMP_LT_OQ));
+            bits |= m << k;
+        }
+        return bits;
+    }
+
+    __attribute__((target("avx512f")))
+    Word avx512(const float* x, float threshold)
+    {
+        const __m512 t = _mm512_set1_ps(threshold);
+        Word bits=0;
+        for( unsigned int k=0; k<64; k+=16){
+            Word m = _mm512_cmp_ps_mask(_mm512_loadu_ps(x+k), t, _CMP_LT_OQ);
+            bits |= m << k;
+        }
+        return bits;
+    }
+#endif
+
+    Kernel choose()
+    {
+#ifdef CLASSIFIER_SIMD
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx512f")) return avx512;
+        if( __builtin_cpu_supports("avx2"))    return avx2;
+#endif
+        return scalar;
+    }
+
+    Kernel kernel()
+    {
+        static const Kernel k = choose();
+        return k;
+    }
+
+    /// smallest float not less than value: for float x, x < value exactly when x < it
+    float ceilFloat(double value)
+    {
+        if( value > FLT_MAX ) return HUGE_VALF;
+        if( value < -FLT_MAX ) return -FLT_MAX;
+        float f = static_cast<float>(value);
+        if( f < value ) f = nextafterf(f, HUGE_VALF);
+        return f;
+    }
+
+    unsigned int popcount(Word w)
+    {
+#ifdef __GNUC__
+        return __builtin_popcountll(w);
+#else
+        unsigned int n=0;
+        for( ; w!=0; w&=w-1) ++n;
+        return n;
+#endif
+    }
+
+    /// order cuts by decreasing rejection
+    bool moreRejection(const CutChain::Cut& a, const CutChain::Cut& b){return a.rejection > b.rejection;}
+}
+
+bool CutChain::isChain(const CompiledTree& model, unsigned int tree)
+{
+    const CompiledTree::Node* root = model.root(tree);
+    const CompiledTree::Node* node = root;
+    while( !node->isLeaf() ){
+        const CompiledTree::Node &left = root[node->child], &right = root[node->child+1];
+        if( left.isLeaf() && left.value==0 )        node = &right;
+        else if( right.isLeaf() && right.value==0 ) node = &left;
+        else return false;
+    }
+    return node->value==1.0;
+}
+
+CutChain::CutChain(const CompiledTree& model, unsigned int tree)
+{
+    if( !isChain(model, tree) ) throw std::invalid_argument("CutChain: tree is not a chain of cuts");
+    const CompiledTree::Node* root = model.root(tree);
+    const CompiledTree::Node* node = root;
+    while( !node->isLeaf() ){
+        const CompiledTree::Node& left = root[node->child];
+        Cut c;
+        c.index = node->index;
+        c.value = node->value;
+        c.threshold = ceilFloat(node->value);
+        c.less = !(left.isLeaf() && left.value==0); // left, value < cut, survives
+        c.rejection = 0;
+        m_cuts.push_back(c);
+        node = c.less? &left : &root[node->child+1];
+    }
+}
+
+CutChain::Word CutChain::test(const Cut& cut, const float* values, size_t n)
+{
+    Word bits;
+    if( n==64 ) bits = kernel()(values, cut.threshold);
+    else {
+        bits=0;
+        for( size_t k=0; k<n; ++k) bits |= Word(values[k] < cut.threshold) << k;
+    }
+    return cut.less? bits : ~bits;
+}
+
+size_t CutChain::evaluate(const float* const* columns, size_t count, Word* mask)const
+{
+    size_t nwords = (count+63)/64;
+    for( size_t w=0; w<nwords; ++w) mask[w] = ~Word(0);
+    if( count%64 !=0 ) mask[nwords-1] = (Word(1) << count%64) - 1;
+
+    for( std::vector<Cut>::const_iterator it=m_cuts.begin(); it!=m_cuts.end(); ++it){
+        const float* column = columns[it->index];
+        Word any=0;
+        for( size_t w=0; w<nwords; ++w){
+            if( mask[w]==0 ) continue; // all rejected already
+            mask[w] &= test(*it, column+64*w, std::min<size_t>(64, count-64*w));
+            any |= mask[w];
+        }
+        if( any==0 ) break;
+    }
+    size_t passed=0;
+    for( size_t w=0; w<nwords; ++w) passed += popcount(mask[w]);
+    return passed;
+}
+
+double CutChain::operator()(const float* row)const
+{
+    for( std::vector<Cut>::const_iterator it=m_cuts.begin(); it!=m_cuts.end(); ++it){
+        if( (row[it->index] < it->value) != it->less ) return 0;
+    }
+    return 1;
+}
+
+void CutChain::order(const float* const* columns, size_t count)
+{
+    for( std::vector<Cut>::iterator it=m_cuts.begin(); it!=m_cuts.end(); ++it){
+        size_t passed=0;
+        for( size_t first=0; first<count; first+=64){
+            passed += popcount(test(*it, columns[it->index]+first, std::min<size_t>(64, count-first))
+                & (count-first>=64? ~Word(0) : (Word(1)<<(count-first))-1));
+        }
+        it->rejection = count>0? 1-double(passed)/count : 0;
+    }
+    std::stable_sort(m_cuts.begin(), m_cuts.end(), moreRejection);
+}
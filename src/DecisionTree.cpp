@@ -7,38 +7,39 @@ $Header: /nfs/slac/g/glast/ground/cvs/classifier/src/DecisionTree.cpp,v 1.4 2005
 */
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #include "classifier/DecisionTree.h"
+#include "classifier/TreeProfile.h"
+#include "classifier/TreeReader.h"
+#include "classifier/TreeSimplifier.h"
 
 #include <stdexcept>
 #include <sstream>
 #include <cassert>
+#include <cmath>
 
-DecisionTree::DecisionTree(std::string title)
-: m_title(title)
-{
-}
-
-DecisionTree::DecisionTree(std::ifstream& input){
-    // first line is the title
-    if( ! input.is_open() ) throw std::invalid_argument("DecisionTree::DecisionTree: bad input file");
-    std::string buffer;
-    std::getline(input, buffer);
-    m_title = buffer;
-
-    while( ! input.eof() ) {
-        Identifier_t id;
-        int index; double value;
-        input >> id >> index >> value;
-        if (id >= 0) {
-            addNode(id, index, value);
-        }
+namespace {
+    /// a double written as C++ source: infinities and NaN are spelled out, since "inf" and "nan" do not compile
+    class Literal {
+    public:
+        explicit Literal(double x): m_x(x){}
+        double value()const{return m_x;}
+    private:
+        double m_x;
+    };
+    std::ostream& operator<<(std::ostream& out, const Literal& literal)
+    {
+        double x = literal.value();
+        if( std::isnan(x) ) return out << "std::numeric_limits<double>::quiet_NaN()";
+        if( std::isinf(x) ) return out << (x<0? "-" : "") << "std::numeric_limits<double>::infinity()";
+        return out << x;
     }
 }
+
 //! @class DecisionTree::Node
 //! @brief Nested class manages the structure of nodes
 class DecisionTree::Node {
 public:
     Node(int index, double value)
-        :m_index(index), m_value(value), m_left(0), m_right(0)
+        :m_index(index), m_value(value), m_left(0), m_right(0), m_right_hot(false), m_cover(0), m_gain(0)
     {
         assert(index>=-10 && index<100); // check for bad logic
     }
@@ -51,64 +52,285 @@ public:
         if( (child_id & 1)!=0) m_right = child;
         else m_left = child;
     }
-    /// templated member function needs an array-type guy
-    template<class C>  
-        double evaluate(const C& values)const
-    {
-        //std::cerr << (m_index>=0? values[m_index]: -1) << "< " << m_value << std::endl;
-        if( isLeaf() ) return m_value;
-        return values[m_index]<m_value
-            ? m_left->evaluate(values)
-            : m_right->evaluate(values) ;
-    }
     bool isLeaf()const{return m_index == -1;}
     Node* left()const{return m_left;}
     Node* right()const{return m_right;}
+    /// the child expected to be taken more often, and the other
+    Node* hot()const{return m_right_hot? m_right : m_left;}
+    Node* cold()const{return m_right_hot? m_left : m_right;}
+    bool rightHot()const{return m_right_hot;}
+    void setRightHot(bool hot){m_right_hot = hot;}
     int index()const{return m_index;}
     double value()const{return m_value;}
+    /// training statistics
+    double cover()const{return m_cover;}
+    double gain()const{return m_gain;}
+    void setStatistics(double cover, double gain){m_cover=cover; m_gain=gain;}
+    /// the outputs of a leaf, empty if it has only its value
+    const std::vector<double>& outputs()const{return m_outputs;}
+    void setOutputs(const std::vector<double>& outputs){m_outputs=outputs;}
 private:
     int m_index;
     double m_value;
     Node* m_left;
     Node* m_right;
+    bool m_right_hot;
+    double m_cover, m_gain;
+    std::vector<double> m_outputs;
 };
+
+DecisionTree::DecisionTree(std::string title)
+: m_title(title)
+, m_stale(true)
+, m_statistics(false)
+{
+}
+
+DecisionTree::DecisionTree(std::ifstream& input)
+: m_stale(true)
+, m_statistics(false)
+{
+    // first line is the title
+    if( ! input.is_open() ) throw std::invalid_argument("DecisionTree::DecisionTree: bad input file");
+    TreeReader reader(input);
+    m_title = reader.title();
+
+    // straight to the compiled form: the nodes are made by expand, only if needed
+    reader.read(m_compiled);
+    m_stale = false;
+    m_statistics = m_compiled.hasStatistics();
+}
+
+DecisionTree::DecisionTree(const TreeIndex& index, const std::vector<unsigned int>& trees)
+: m_title(index.title())
+, m_stale(false)
+, m_statistics(false)
+, m_index(index)
+, m_pending(trees)
+{
+}
+
+void DecisionTree::load()const
+{
+    if( m_pending.empty() ) return;
+    m_index.read(m_compiled, m_pending);
+    m_pending.clear();
+    m_statistics = m_compiled.hasStatistics();
+}
+namespace {
+    /// check that all leaves are 0 or 1
+    bool isFilter(const DecisionTree::Node* node)
+    {
+        if( node->isLeaf() ) return node->value()==0 || node->value()==1.0;
+        return isFilter(node->left()) && isFilter(node->right());
+    }
+
+    /// number of outputs of a tree, from its first leaf
+    unsigned int outputsOf(const DecisionTree::Node* node)
+    {
+        while( node!=0 && !node->isLeaf() ) node = node->left();
+        return node==0 || node->outputs().empty()? 1 : node->outputs().size();
+    }
+}
+
 DecisionTree::~DecisionTree()
 { 
 }
 double DecisionTree::operator()(const std::vector<float>& row, int tree_count)const
 {
-    class FloatVector : public Values 
-    { public:
-    FloatVector(const std::vector<float>& row): m_row(row){}
-    double operator[](int index)const{return m_row[index];}
-    std::vector<float> m_row; // make a local copy
-    } vals(row);
-
-    return (*this)(vals);
+    return compiled()(row, tree_count>0? tree_count : 0);
 }
 double DecisionTree::operator ()(const Values& vals) const
 {
-    double weighted_sum=0, sum_of_weights=0;
+    return compiled()(vals);
+}
+namespace {
+    void checkSize(size_t size, const CompiledTree& model, const char* method="operator()")
+    {
+        if( size < static_cast<size_t>(model.width()) ) {
+            throw std::invalid_argument(std::string("DecisionTree::")+method+": row is shorter than the variables used");
+        }
+    }
+}
+double DecisionTree::operator()(const float* row, size_t size) const
+{
+    const CompiledTree& model = compiled();
+    checkSize(size, model);
+    return model(row);
+}
+double DecisionTree::operator()(const double* row, size_t size) const
+{
+    const CompiledTree& model = compiled();
+    checkSize(size, model);
+    return model(row);
+}
+
+bool DecisionTree::accept(const float* row, size_t size, double cut) const
+{
+    const CompiledTree& model = compiled();
+    checkSize(size, model);
+    return model.accept(row, cut);
+}
+
+void DecisionTree::evaluateAll(const float* row, size_t size, double* result, int tree_count)const
+{
+    const CompiledTree& model = compiled();
+    checkSize(size, model);
+    model.evaluateAll(row, result, tree_count>0? tree_count : 0);
+}
+
+void DecisionTree::evaluateAll(const std::vector<float>& row, std::vector<double>& result, int tree_count)const
+{
+    const CompiledTree& model = compiled();
+    result.resize(model.outputs());
+    model.evaluateAll(row, &result[0], tree_count>0? tree_count : 0);
+}
+
+void DecisionTree::evaluateAll(const float* rows, size_t count, size_t stride, double* result, int tree_count)const
+{
+    const CompiledTree& model = compiled();
+    if( count>0 ) checkSize(stride, model, "evaluateAll");
+    model.evaluateAll(rows, count, stride, result, tree_count>0? tree_count : 0);
+}
+
+void DecisionTree::evaluate(const float* rows, size_t count, size_t stride, double* scores, int tree_count)const
+{
+    const CompiledTree& model = compiled();
+    if( count>0 ) checkSize(stride, model, "evaluate");
+    model.evaluate(rows, count, stride, scores, tree_count>0? tree_count : 0);
+}
+
+void DecisionTree::evaluate(const float* const* columns, size_t count, double* scores, int tree_count)const
+{
+    compiled().evaluate(columns, count, scores, tree_count>0? tree_count : 0);
+}
+
+const CompiledTree& DecisionTree::compiled()const
+{
+    load();
+    if( m_stale ) compile();
+    return m_compiled;
+}
+
+void DecisionTree::compileNode(std::vector<CompiledTree::Node>& nodes, std::vector<CompiledTree::Statistics>* statistics,
+                               std::vector<double>& values, const DecisionTree::Node * node, unsigned int position)const
+{
+    if( node==0 ) throw std::runtime_error("DecisionTree::compile: incomplete tree");
+    CompiledTree::Node& flat = nodes[position];
+    flat.value = node->value();
+    flat.index = node->isLeaf()? -1 : node->index();
+    flat.child = 0;
+    if( statistics!=0 ){
+        statistics->resize(nodes.size());
+        (*statistics)[position].cover = node->cover();
+        (*statistics)[position].gain = node->gain();
+    }
+    if( node->isLeaf() ){
+        // the outputs, if any, go to values, and the leaf points to them
+        const std::vector<double>& outputs = node->outputs();
+        if( outputs.empty() ) return;
+        nodes[position].child = values.size();
+        values.insert(values.end(), outputs.begin(), outputs.end());
+        return;
+    }
+
+    // the pair of children goes next, then the subtree of the hot one, then the other
+    unsigned int pair = nodes.size();
+    nodes[position].child = pair;
+    nodes.resize(pair+2);
+    unsigned int hot = node->rightHot()? 1 : 0;
+    compileNode(nodes, statistics, values, node->hot(), pair+hot);
+    compileNode(nodes, statistics, values, node->cold(), pair+1-hot);
+}
+
+namespace {
+    /// make the nodes of a compiled subtree
+    DecisionTree::Node* expandNode(const CompiledTree& model, unsigned int tree, unsigned int position)
+    {
+        const CompiledTree::Node* root = model.root(tree);
+        const CompiledTree::Statistics* statistics = model.statistics(tree);
+        const CompiledTree::Node& flat = root[position];
+        DecisionTree::Node* node = new DecisionTree::Node(flat.isLeaf()? -1 : flat.index, flat.value);
+        if( statistics!=0 ) node->setStatistics(statistics[position].cover, statistics[position].gain);
+        if( flat.isLeaf() ){
+            if( model.outputs()>1 && model.tree(tree).weight > 0 ) {
+                const double* outputs = model.outputs(flat);
+                node->setOutputs(std::vector<double>(outputs, outputs+model.outputs()));
+            }
+            return node;
+        }
+        const CompiledTree::Node& left = root[flat.child], & right = root[flat.child+1];
+        // the hot child's pair comes first, but that shows only if both are branches
+        node->setRightHot( !left.isLeaf() && !right.isLeaf() && right.child < left.child );
+        node->setChild(2, expandNode(model, tree, flat.child));
+        node->setChild(3, expandNode(model, tree, flat.child+1));
+        return node;
+    }
+}
+
+void DecisionTree::expand()const
+{
+    load();
+    if( !m_rootlist.empty() || m_stale ) return;
+    for( unsigned int tree=0; tree<m_compiled.treeCount(); ++tree){
+        m_rootlist.push_back(std::make_pair(m_compiled.tree(tree).weight, 
+            expandNode(m_compiled, tree, 0)));
+    }
+}
+
+void DecisionTree::compile()const
+{
+    load();
+    if( !m_stale ) return; // up to date: as read from a file, or compiled since the last change
+    expand();
+    m_compiled.clear();
     std::vector<std::pair<double, Node*> >::const_iterator it= m_rootlist.begin();
     for( ; it!=m_rootlist.end(); ++it){ 
-        double 
-            weight = (*it).first, // weight associated with this tree
-            value = (*it).second->evaluate(vals); // get the value for input vars
-        if( weight <= 0. ){
-            // this is a filter: if zero result, just return
-            if( value == 0) return 0;
-            if( value != 1.0 ) {
-                throw std::runtime_error(
-                    "DecisionTree::operator(): processing a filter, expect only 0 or 1 leaf nodes");
-            }
-            continue; // otherwise go to next tree
+        std::vector<CompiledTree::Node> nodes(1);
+        std::vector<CompiledTree::Statistics> statistics;
+        std::vector<double> values;
+        compileNode(nodes, m_statistics? &statistics : 0, values, it->second, 0);
+        unsigned int outputs = outputsOf(it->second);
+        if( !values.empty() && values.size() != outputs*((nodes.size()+1)/2) ) {
+            throw std::runtime_error("DecisionTree::compile: leaves with different numbers of outputs");
         }
-        // not a filter: continue
-        sum_of_weights += weight;
-        weighted_sum += weight * value;
+        m_compiled.addTree(it->first, nodes, statistics, outputs, values);
     }
-    // done with loop: note that if there were no trees, we accept.
-    return sum_of_weights != 0 ? weighted_sum/sum_of_weights : 1;
+    m_stale = false;
+}
+
+namespace {
+    /// set the hot child of each branch node, from the visits counted by the profile
+    void setHot(DecisionTree::Node* node, const TreeProfile& profile, unsigned int tree, unsigned int position)
+    {
+        if( node->isLeaf() ) return;
+        unsigned int child = profile.model().root(tree)[position].child;
+        node->setRightHot( profile.visits(tree, child+1) > profile.visits(tree, child) );
+        setHot(node->left(), profile, tree, child);
+        setHot(node->right(), profile, tree, child+1);
+    }
+}
+
+void DecisionTree::optimizeLayout(const float* rows, size_t count, size_t stride)
+{
+    expand();
+    TreeProfile profile(*this);
+    std::vector<double> scores(count);
+    if( count>0 ) profile.evaluate(rows, count, stride, &scores[0]);
+    profile.merge();
+    for( unsigned int tree=0; tree<m_rootlist.size(); ++tree){
+        setHot(m_rootlist[tree].second, profile, tree, 0);
+    }
+    m_stale = true;
+}
+
+void DecisionTree::simplify(bool merge)
+{
+    TreeSimplifier simplifier(compiled(), merge);
+    m_compiled = simplifier.model();
+    // the nodes are made again from the compiled form if needed: the old ones may be shared
+    m_rootlist.clear();
+    m_stale = false;
 }
 
 DecisionTree::Node* DecisionTree::find(Identifier_t id)
@@ -135,6 +357,8 @@ DecisionTree::Node* DecisionTree::find(Identifier_t id)
 
 void DecisionTree::addNode(Identifier_t id, int index, double value)
 {
+    expand();
+    m_stale = true;
     Node * child = new Node(index, value);
     if ( id==0 ) { 
         // starting new tree: expect next call do have id = 1
@@ -157,38 +381,139 @@ void DecisionTree::addNode(Identifier_t id, int index, double value)
     }
 }
 
+void DecisionTree::addNode(Identifier_t id, int index, double value, double cover, double gain)
+{
+    addNode(id, index, value);
+    if( id==0 ) return; // the tree weight
+    Node* node = id==1? m_rootlist.back().second : find(id);
+    node->setStatistics(cover, gain);
+    m_statistics = true;
+}
+
+void DecisionTree::addLeaf(Identifier_t id, double value, const std::vector<double>& outputs)
+{
+    if( id<1 ) throw std::invalid_argument("DecisionTree::addLeaf: not a node id");
+    if( outputs.size()<2 ) throw std::invalid_argument("DecisionTree::addLeaf: expect at least two outputs");
+    addNode(id, -1, value);
+    Node* node = id==1? m_rootlist.back().second : find(id);
+    node->setOutputs(outputs);
+}
+
+void DecisionTree::addLeaf(Identifier_t id, double value, const std::vector<double>& outputs, double cover)
+{
+    addLeaf(id, value, outputs);
+    Node* node = id==1? m_rootlist.back().second : find(id);
+    node->setStatistics(cover, 0);
+    m_statistics = true;
+}
+
 void DecisionTree::addTree(const DecisionTree * tree)
 {
     if( m_title != tree->title()) {
         throw std::runtime_error("DecisionTree::addTree - merging trees of different flavours");
     } else {
+        expand();
+        tree->expand();
         m_rootlist.insert(m_rootlist.end(),tree->m_rootlist.begin(),tree->m_rootlist.end());
+        m_statistics = m_statistics || tree->m_statistics;
+        m_stale = true;
     }
 }
 
-void DecisionTree::printNode(std::ostream& out , const DecisionTree::Node * node, Identifier_t id)const
+void DecisionTree::printNode(std::ostream& out , const DecisionTree::Node * node, Identifier_t id, bool statistics)const
 {
     assert (node!=0); // baad logic!
-    out << "\t"<< id << "\t" << node->index() <<"\t" << node->value() << std::endl;
+    out << "\t"<< id << "\t" << node->index() <<"\t" << node->value();
+    const std::vector<double>& outputs = node->outputs();
+    for( std::vector<double>::const_iterator it=outputs.begin(); it!=outputs.end(); ++it) out << "\t" << *it;
+    if( statistics ) out << "\t" << node->cover() << "\t" << node->gain();
+    out << std::endl;
     if( node-> isLeaf()) return;
-    printNode(out,node->left(), 2*id);
-    printNode(out,node->right(), 2*id+1);
+    // the hot child first: see optimizeLayout
+    Identifier_t hot = node->rightHot()? 1 : 0;
+    printNode(out,node->hot(), 2*id+hot, statistics);
+    printNode(out,node->cold(), 2*id+1-hot, statistics);
 
 }
-void DecisionTree::print(std::ostream& out)const
+void DecisionTree::print(std::ostream& out, bool statistics)const
 {
     out << m_title << std::endl;
+    expand();
+    statistics = statistics && m_statistics;
     std::vector<std::pair<double, Node*> >::const_iterator it= m_rootlist.begin();
     for( ; it!=m_rootlist.end(); ++it){ 
         // first line identifies start of tree: not an actual "node"
-        out << "\t0\t-10\t" << (*it).first << std::endl;
+        out << "\t0\t-10\t" << (*it).first;
+        unsigned int outputs = outputsOf(it->second);
+        if( outputs>1 ) out << "\t" << outputs;
+        out << std::endl;
         // now do the tree, root node has id 1.
-        printNode(out, (*it).second, 1);
+        printNode(out, (*it).second, 1, statistics);
+    }
+}
+
+void DecisionTree::printCodeNode(std::ostream& out , const DecisionTree::Node * node, int depth)const
+{
+    assert (node!=0); // baad logic!
+    std::string indent(4*depth, ' ');
+    if( node->isLeaf() ){
+        out << indent << "return " << Literal(node->value()) << ";\n";
+        return;
     }
+    // the likely outcome first. Written as !(x < cut), not x >= cut, for NaN
+    out << indent << "if( " << (node->rightHot()? "!(" : "")
+        << "row[" << node->index() << "] < " << Literal(node->value())
+        << (node->rightHot()? ")" : "") << " ) {\n";
+    printCodeNode(out, node->hot(), depth+1);
+    out << indent << "} else {\n";
+    printCodeNode(out, node->cold(), depth+1);
+    out << indent << "}\n";
+}
+
+void DecisionTree::printCode(std::ostream& out, const std::string& name)const
+{
+    // check the filters now, since the generated code will not
+    expand();
+    std::vector<std::pair<double, Node*> >::const_iterator it= m_rootlist.begin();
+    for( ; it!=m_rootlist.end(); ++it){
+        if( it->first<=0 && !isFilter(it->second) ) {
+            throw std::runtime_error("DecisionTree::printCode: filter with a leaf not 0 or 1");
+        }
+    }
+
+    std::streamsize precision = out.precision(17); // enough for any double
+    out << "// Evaluation of the DecisionTree \"" << m_title << "\"\n"
+        << "// generated by DecisionTree::printCode: do not edit\n"
+        << "#include <stddef.h>\n"
+        << "#include <limits>\n\n";
+    int n=0;
+    for( it=m_rootlist.begin(); it!=m_rootlist.end(); ++it, ++n){
+        out << "// tree " << n << ", weight " << it->first << "\n"
+            << "static double " << name << "_tree" << n << "(const float* row)\n{\n";
+        printCodeNode(out, it->second, 1);
+        out << "}\n\n";
+    }
+    out << "extern \"C\" double " << name << "(const float* row)\n{\n"
+        << "    double weighted_sum=0, sum_of_weights=0;\n";
+    for( it=m_rootlist.begin(), n=0; it!=m_rootlist.end(); ++it, ++n){
+        double weight = it->first;
+        if( weight <= 0 ){
+            out << "    if( " << name << "_tree" << n << "(row) == 0 ) return 0; // filter\n";
+            continue;
+        }
+        out << "    sum_of_weights += " << Literal(weight) << ";\n"
+            << "    weighted_sum += " << Literal(weight) << " * " << name << "_tree" << n << "(row);\n";
+    }
+    out << "    return sum_of_weights != 0 ? weighted_sum/sum_of_weights : 1;\n}\n\n";
+
+    out << "extern \"C\" void " << name << "_block(const float* rows, size_t count, size_t stride, double* scores)\n{\n"
+        << "    for( size_t i=0; i<count; ++i) scores[i] = " << name << "(rows+i*stride);\n}\n";
+    out.precision(precision);
 }
 
 void DecisionTree::printFilter(const std::vector<std::string>& varnames, std::ostream& out, std::string indent)const
 {
+    expand();
     std::vector<std::pair<double, Node*> >::const_iterator it= m_rootlist.begin();
     Node* node = it->second;
 
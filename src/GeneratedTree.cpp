@@ -0,0 +1,57 @@
+/** @file  GeneratedTree.cpp
+    @brief implementation of class GeneratedTree
+
+    $Header$
+*/
+#include "classifier/GeneratedTree.h"
+
+#include <stdexcept>
+#ifdef WIN32
+# include <windows.h>
+#else
+# include <dlfcn.h>
+#endif
+
+namespace {
+    void* open(const std::string& library)
+    {
+#ifdef WIN32
+        return LoadLibrary(library.c_str());
+#else
+        return dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+    }
+    void* symbol(void* handle, const std::string& name)
+    {
+#ifdef WIN32
+        return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(handle), name.c_str()));
+#else
+        return dlsym(handle, name.c_str());
+#endif
+    }
+    void close(void* handle)
+    {
+#ifdef WIN32
+        FreeLibrary(static_cast<HMODULE>(handle));
+#else
+        dlclose(handle);
+#endif
+    }
+}
+
+GeneratedTree::GeneratedTree(const std::string& library, const std::string& name)
+: m_handle(open(library))
+{
+    if( m_handle==0 ) throw std::runtime_error("GeneratedTree: could not load library "+library);
+    m_function = reinterpret_cast<Function>(symbol(m_handle, name));
+    m_block = reinterpret_cast<BlockFunction>(symbol(m_handle, name+"_block"));
+    if( m_function==0 || m_block==0 ) {
+        close(m_handle);
+        throw std::runtime_error("GeneratedTree: function "+name+" not found in "+library);
+    }
+}
+
+GeneratedTree::~GeneratedTree()
+{
+    close(m_handle);
+}
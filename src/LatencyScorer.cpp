@@ -0,0 +1,144 @@
+/** @file  LatencyScorer.cpp
+    @brief implementation of class LatencyScorer
+
+    $Header$
+*/
+#include "classifier/LatencyScorer.h"
+
+#include <cstdint>
+#include <stdexcept>
+#ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+unsigned int LatencyScorer::s_spin = 100000;
+
+namespace {
+    /// wait a little: pause at first, then let other threads run
+    inline void relax(unsigned int& spins)
+    {
+        if( ++spins < LatencyScorer::s_spin ){
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_ia32_pause();
+#endif
+        }else{
+            std::this_thread::yield();
+        }
+    }
+
+    void pin(std::thread& thread, int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set); // a hint: ignore failure
+#else
+        (void)thread; (void)cpu;
+#endif
+    }
+}
+
+LatencyScorer::LatencyScorer(const CompiledTree& model, unsigned int nthreads, int first_cpu)
+: m_model(model)
+, m_leaves(0)
+, m_row(0)
+, m_generation(0)
+, m_stop(false)
+, m_finished(0)
+{
+    if( nthreads==0 ) throw std::invalid_argument("LatencyScorer: need at least one thread");
+    // spinning threads that share a core only wait for each other
+    unsigned int cores = std::thread::hardware_concurrency();
+    if( cores>0 && nthreads > cores ) nthreads = cores;
+    if( nthreads > model.treeCount() && model.treeCount()>0 ) nthreads = model.treeCount();
+
+    // contiguous groups with about the same number of nodes
+    size_t total = model.size(), sum=0;
+    m_first.push_back(0);
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        sum += model.treeSize(tree);
+        if( m_first.size() < nthreads && sum*nthreads >= total*m_first.size() ) m_first.push_back(tree+1);
+    }
+    while( m_first.size() < nthreads+1 ) m_first.push_back(model.treeCount());
+
+    // the leaf values of each group start a cache line, so that no two threads write to the same one
+    const size_t line = 64/sizeof(double);
+    size_t position=0;
+    for( unsigned int part=0; part<nthreads; ++part){
+        m_start.push_back(position);
+        position += (m_first[part+1]-m_first[part]+line-1)/line*line;
+    }
+    m_leaf_store.resize(position+line);
+    size_t skip = (64 - reinterpret_cast<std::uintptr_t>(&m_leaf_store[0])%64)%64;
+    m_leaves = &m_leaf_store[0] + skip/sizeof(double);
+
+    for( unsigned int part=1; part<nthreads; ++part){
+        m_threads.push_back(std::thread(&LatencyScorer::work, this, part));
+        if( first_cpu>=0 ) pin(m_threads.back(), first_cpu+part-1);
+    }
+}
+
+LatencyScorer::~LatencyScorer()
+{
+    m_stop.store(true, std::memory_order_release);
+    for( size_t t=0; t<m_threads.size(); ++t) m_threads[t].join();
+}
+
+void LatencyScorer::evaluate(unsigned int part, const float* row)
+{
+    double* leaves = m_leaves + m_start[part];
+    unsigned int first = m_first[part];
+    for( unsigned int tree=first; tree<m_first[part+1]; ++tree){
+        leaves[tree-first] = m_model.evaluate(tree, row);
+    }
+}
+
+void LatencyScorer::work(unsigned int part)
+{
+    unsigned long seen=0;
+    for(;;){
+        unsigned int spins=0;
+        unsigned long generation;
+        while( (generation=m_generation.load(std::memory_order_acquire))==seen ){
+            if( m_stop.load(std::memory_order_acquire) ) return;
+            relax(spins);
+        }
+        seen = generation;
+        evaluate(part, m_row);
+        m_finished.fetch_add(1, std::memory_order_release);
+    }
+}
+
+double LatencyScorer::operator()(const float* row)
+{
+    // fan out: the workers see the row once they see the new generation
+    m_row = row;
+    m_finished.store(0, std::memory_order_relaxed);
+    m_generation.fetch_add(1, std::memory_order_release);
+    evaluate(0, row);
+
+    // fan in
+    unsigned int spins=0;
+    while( m_finished.load(std::memory_order_acquire) != m_threads.size() ) relax(spins);
+
+    // combine in tree order, as CompiledTree::operator()
+    double weighted_sum=0, sum_of_weights=0;
+    unsigned int part=0;
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        while( tree>=m_first[part+1] ) ++part;
+        double weight = m_model.tree(tree).weight, value = m_leaves[m_start[part] + tree-m_first[part]];
+        if( weight <= 0 ){
+            if( value == 0 ) return 0;
+            if( value != 1.0 ) {
+                throw std::runtime_error(
+                    "LatencyScorer: processing a filter, expect only 0 or 1 leaf nodes");
+            }
+            continue;
+        }
+        sum_of_weights += weight;
+        weighted_sum += weight * value;
+    }
+    return sum_of_weights != 0 ? weighted_sum/sum_of_weights : 1;
+}
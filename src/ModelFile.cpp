@@ -0,0 +1,276 @@
+/** @file  ModelFile.cpp
+    @brief implementation of class ModelFile
+
+    $Header$
+*/
+#include "classifier/ModelFile.h"
+#include "classifier/DecisionTree.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#ifdef WIN32
+# include <windows.h>
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace {
+    const char magic[8] = {'D','T','R','E','E','B','I','N'};
+    const unsigned int byte_order = 0x01020304;
+
+    struct Header {
+        char magic[8];
+        unsigned int byte_order;
+        unsigned int version;
+        unsigned int node_size;   ///< sizeof(CompiledTree::Node)
+        unsigned int record_size; ///< sizeof(TreeRecord)
+        unsigned long long tree_count, node_count, var_count;
+        unsigned long long trees, nodes, strings, strings_size; ///< positions in the file
+        unsigned long long file_size;
+        unsigned long long checksum; ///< of everything after the header
+    };
+
+    /// follows the header in version 2, for trees with several outputs
+    struct OutputsRecord {
+        unsigned long long outputs, value_count;
+        unsigned long long values; ///< position in the file
+    };
+
+    struct TreeRecord {
+        double weight;
+        unsigned long long offset;
+    };
+
+    /// round up to a multiple of 16
+    size_t align(size_t n){ return (n+15) & ~size_t(15); }
+
+    /// FNV-1a, a word at a time: the length is a multiple of 8
+    unsigned long long checksum(const char* data, size_t length)
+    {
+        unsigned long long hash = 14695981039346656037ULL, word;
+        for( size_t k=0; k+8<=length; k+=8){
+            std::memcpy(&word, data+k, 8);
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /// count items of the size, from start, end by limit: tested without forming a product that can overflow
+    bool within(unsigned long long start, unsigned long long count, size_t size, unsigned long long limit)
+    {
+        return start <= limit && count <= (limit-start)/size;
+    }
+
+    void fail(const std::string& filename, const std::string& why)
+    {
+        throw std::runtime_error("ModelFile: "+filename+": "+why);
+    }
+}
+
+const unsigned int ModelFile::s_version;
+
+void ModelFile::write(const std::string& filename, const DecisionTree& dtree, const std::vector<std::string>& vars)
+{
+    write(filename, dtree.compiled(), dtree.title(), vars);
+}
+
+void ModelFile::write(const std::string& filename, const CompiledTree& model, const std::string& title,
+                      const std::vector<std::string>& vars)
+{
+    if( model.width() > static_cast<int>(vars.size()) ) {
+        throw std::invalid_argument("ModelFile::write: tree uses more variables than given");
+    }
+    std::string strings(title.c_str(), title.size()+1);
+    for( std::vector<std::string>::const_iterator it=vars.begin(); it!=vars.end(); ++it){
+        strings.append(it->c_str(), it->size()+1);
+    }
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.byte_order = byte_order;
+    bool several = model.outputs()>1; // only then version 2, which older readers reject
+    h.version = several? s_version : 1;
+    h.node_size = sizeof(CompiledTree::Node);
+    h.record_size = sizeof(TreeRecord);
+    h.tree_count = model.treeCount();
+    h.node_count = model.size();
+    h.var_count = vars.size();
+    OutputsRecord o;
+    std::memset(&o, 0, sizeof(o));
+    o.outputs = model.outputs();
+    o.value_count = model.valueCount();
+    h.trees = align(sizeof(Header) + (several? sizeof(OutputsRecord) : 0));
+    h.nodes = align(h.trees + h.tree_count*sizeof(TreeRecord));
+    o.values = h.nodes + h.node_count*sizeof(CompiledTree::Node);
+    h.strings = several? o.values + o.value_count*sizeof(double) : o.values;
+    h.strings_size = strings.size();
+    h.file_size = align(h.strings + h.strings_size);
+
+    // everything after the header, with zero padding
+    std::vector<char> body(h.file_size - sizeof(Header), 0);
+    char* base = &body[0] - sizeof(Header);
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        TreeRecord r;
+        std::memset(&r, 0, sizeof(r));
+        r.weight = model.tree(tree).weight;
+        r.offset = model.tree(tree).offset;
+        std::memcpy(base + h.trees + tree*sizeof(r), &r, sizeof(r));
+    }
+    if( h.node_count>0 ) std::memcpy(base + h.nodes, model.nodes(), h.node_count*sizeof(CompiledTree::Node));
+    if( several ){
+        std::memcpy(base + sizeof(Header), &o, sizeof(o));
+        std::memcpy(base + o.values, model.values(), o.value_count*sizeof(double));
+    }
+    std::memcpy(base + h.strings, strings.data(), strings.size());
+    h.checksum = checksum(&body[0], body.size());
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    if( !out.is_open() ) throw std::invalid_argument("ModelFile::write: cannot open "+filename);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(&body[0], body.size());
+    if( !out ) throw std::runtime_error("ModelFile::write: error writing "+filename);
+}
+
+bool ModelFile::isModelFile(const std::string& filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    char start[sizeof(magic)];
+    return in.read(start, sizeof(start)) && std::memcmp(start, magic, sizeof(magic))==0;
+}
+
+ModelFile::ModelFile(const std::string& filename, bool verify)
+: m_address(0)
+, m_length(0)
+, m_handle(0)
+{
+#ifdef WIN32
+    HANDLE file = CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+    if( file==INVALID_HANDLE_VALUE ) throw std::invalid_argument("ModelFile: cannot open "+filename);
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    m_length = static_cast<size_t>(size.QuadPart);
+    m_handle = m_length>0? CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0) : 0;
+    CloseHandle(file);
+    if( m_handle!=0 ) m_address = MapViewOfFile(m_handle, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if( fd<0 ) throw std::invalid_argument("ModelFile: cannot open "+filename);
+    struct stat info;
+    if( ::fstat(fd, &info)==0 ) m_length = info.st_size;
+    if( m_length>0 ) {
+        m_address = ::mmap(0, m_length, PROT_READ, MAP_SHARED, fd, 0);
+        if( m_address==MAP_FAILED ) m_address = 0;
+    }
+    ::close(fd);
+#endif
+    try {
+        if( m_address==0 ) fail(filename, "cannot map");
+        if( m_length < sizeof(Header) ) fail(filename, "too short");
+        const char* base = static_cast<const char*>(m_address);
+        Header h;
+        std::memcpy(&h, base, sizeof(h));
+        if( std::memcmp(h.magic, magic, sizeof(magic))!=0 ) fail(filename, "not a model file");
+        if( h.byte_order!=byte_order ) fail(filename, "written with a different byte order");
+        if( h.version!=1 && h.version!=s_version ) fail(filename, "unsupported version");
+        OutputsRecord o;
+        std::memset(&o, 0, sizeof(o));
+        o.outputs = 1;
+        if( h.version>=2 ){
+            if( m_length < sizeof(Header)+sizeof(OutputsRecord) ) fail(filename, "too short");
+            std::memcpy(&o, base+sizeof(Header), sizeof(o));
+            o.value_count = o.outputs>1? o.value_count : 0;
+        }
+        if( h.node_size!=sizeof(CompiledTree::Node) || h.record_size!=sizeof(TreeRecord) ) {
+            fail(filename, "written with a different node layout");
+        }
+        if( h.file_size!=m_length
+            || h.trees < sizeof(Header) || !within(h.trees, h.tree_count, sizeof(TreeRecord), h.nodes) || h.nodes%16!=0
+            || !within(h.nodes, h.node_count, sizeof(CompiledTree::Node), h.strings)
+            || (o.value_count>0 && (o.values%8!=0 || o.values < h.nodes + h.node_count*sizeof(CompiledTree::Node)
+                || !within(o.values, o.value_count, sizeof(double), h.strings)))
+            || !within(h.strings, h.strings_size, 1, h.file_size) ) {
+            fail(filename, "inconsistent header, or truncated");
+        }
+        if( verify && checksum(base+sizeof(Header), m_length-sizeof(Header))!=h.checksum ) {
+            fail(filename, "checksum does not match");
+        }
+
+        // the strings: title, then the variable names
+        const char* s = base + h.strings, *end = s + h.strings_size;
+        for( unsigned long long k=0; k<=h.var_count; ++k){
+            const char* stop = static_cast<const char*>(std::memchr(s, 0, end-s));
+            if( stop==0 ) fail(filename, "bad names");
+            if( k==0 ) m_title = std::string(s, stop);
+            else m_vars.push_back(std::string(s, stop));
+            s = stop+1;
+        }
+
+        std::vector<CompiledTree::Tree> trees(h.tree_count);
+        for( unsigned int tree=0; tree<trees.size(); ++tree){
+            TreeRecord r;
+            std::memcpy(&r, base + h.trees + tree*sizeof(r), sizeof(r));
+            trees[tree].weight = r.weight;
+            trees[tree].offset = r.offset;
+        }
+        if( o.outputs==0 || o.outputs>0xffffffffULL ) fail(filename, "bad number of outputs");
+        m_model.view(reinterpret_cast<const CompiledTree::Node*>(base + h.nodes), h.node_count, trees,
+            static_cast<unsigned int>(o.outputs), reinterpret_cast<const double*>(base + o.values), o.value_count);
+        if( m_model.width() > static_cast<int>(m_vars.size()) ) fail(filename, "variable index out of range");
+    }catch(...){
+        unmap();
+        throw;
+    }
+}
+
+ModelFile::~ModelFile()
+{
+    unmap();
+}
+
+void ModelFile::unmap()
+{
+#ifdef WIN32
+    if( m_address!=0 ) UnmapViewOfFile(m_address);
+    if( m_handle!=0 ) CloseHandle(m_handle);
+#else
+    if( m_address!=0 ) ::munmap(m_address, m_length);
+#endif
+    m_address = 0;
+    m_handle = 0;
+}
+
+void ModelFile::printNode(std::ostream& out, unsigned int tree, unsigned int node, long long id)const
+{
+    const CompiledTree::Node* root = m_model.root(tree);
+    const CompiledTree::Node& n = root[node];
+    out << "\t" << id << "\t" << n.index << "\t" << n.value;
+    if( n.isLeaf() && m_model.outputs()>1 && m_model.tree(tree).weight > 0 ){
+        const double* outputs = m_model.outputs(n);
+        for( unsigned int k=0; k<m_model.outputs(); ++k) out << "\t" << outputs[k];
+    }
+    out << std::endl;
+    if( n.isLeaf() ) return;
+    // the child whose subtree was placed first is the hot one: see DecisionTree::optimizeLayout
+    const CompiledTree::Node &left = root[n.child], &right = root[n.child+1];
+    unsigned int hot = !left.isLeaf() && !right.isLeaf() && right.child < left.child ? 1 : 0;
+    printNode(out, tree, n.child+hot, 2*id+hot);
+    printNode(out, tree, n.child+1-hot, 2*id+1-hot);
+}
+
+void ModelFile::print(std::ostream& out)const
+{
+    std::streamsize precision = out.precision(17); // the doubles as written, for TreeReader
+    out << m_title << std::endl;
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        out << "\t0\t-10\t" << m_model.tree(tree).weight;
+        if( m_model.outputs()>1 && m_model.tree(tree).weight > 0 ) out << "\t" << m_model.outputs();
+        out << std::endl;
+        printNode(out, tree, 0, 1);
+    }
+    out.precision(precision);
+}
@@ -0,0 +1,163 @@
+/** @file  ModelHandle.cpp
+    @brief implementation of class ModelHandle
+
+    $Header$
+*/
+#include "classifier/ModelHandle.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <sys/stat.h>
+
+const unsigned int ModelHandle::s_stripes;
+
+namespace {
+    /// read a model, away from the readers: it is read in the compiled form
+    DecisionTree* readModel(const std::string& filename)
+    {
+        std::ifstream in(filename.c_str());
+        if( !in.is_open() ) throw std::runtime_error("ModelHandle: could not open "+filename);
+        return new DecisionTree(in);
+    }
+
+    /// the stripe of the calling thread
+    unsigned int stripe()
+    {
+        static thread_local unsigned int mine =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % ModelHandle::s_stripes;
+        return mine;
+    }
+}
+
+ModelHandle::ModelHandle(const std::string& filename, double poll)
+: m_filename(filename)
+, m_current(0)
+, m_phase(0)
+, m_generation(0)
+, m_time(0)
+, m_size(0)
+, m_poll(poll)
+, m_stop(false)
+{
+    for( unsigned int s=0; s<s_stripes; ++s){
+        m_stripes[s].count[0] = 0;
+        m_stripes[s].count[1] = 0;
+    }
+    reload();
+    if( m_poll>0 ) m_watcher = std::thread(&ModelHandle::watch, this);
+}
+
+ModelHandle::~ModelHandle()
+{
+    if( m_watcher.joinable() ){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_watcher.join();
+    }
+    delete m_current.load();
+}
+
+std::atomic<long>& ModelHandle::enter()const
+{
+    std::atomic<long>& count = m_stripes[stripe()].count[m_phase.load() & 1];
+    count.fetch_add(1);
+    return count;
+}
+
+ModelHandle::Reader::Reader(const ModelHandle& handle)
+: m_count(handle.enter())
+, m_model(handle.m_current.load()) // after counting in: see synchronize
+{}
+
+ModelHandle::Reader::~Reader()
+{
+    m_count.fetch_sub(1);
+}
+
+void ModelHandle::evaluate(const float* rows, size_t count, size_t stride, double* scores)const
+{
+    Reader model(*this);
+    model->evaluate(rows, count, stride, scores);
+}
+
+void ModelHandle::synchronize()
+{
+    // A reader that loaded the old pointer counted in before the exchange, and its counter
+    // is not zero until it is done. Each counter must be seen at zero after the exchange;
+    // switching the phase first lets the counter drain, as new readers use the other one.
+    for( int pass=0; pass<2; ++pass){
+        unsigned int old = m_phase.fetch_add(1) & 1;
+        for( unsigned int s=0; s<s_stripes; ++s){
+            while( m_stripes[s].count[old].load()!=0 ) std::this_thread::yield();
+        }
+    }
+}
+
+void ModelHandle::publish(DecisionTree* model)
+{
+    if( model==0 ) throw std::invalid_argument("ModelHandle::publish: no model");
+    model->compile(); // nothing to do for one read from a file
+    std::lock_guard<std::mutex> lock(m_publish);
+    DecisionTree* old = m_current.exchange(model);
+    ++m_generation;
+    if( old==0 ) return;
+    synchronize();
+    delete old;
+}
+
+void ModelHandle::reload()
+{
+    long long time, size;
+    stamp(time, size);
+    publish(readModel(m_filename));
+    std::lock_guard<std::mutex> lock(m_publish);
+    m_time = time;
+    m_size = size;
+}
+
+void ModelHandle::stamp(long long& time, long long& size)const
+{
+    struct stat info;
+    if( stat(m_filename.c_str(), &info)!=0 ) { time = size = 0; return; }
+    time = info.st_mtime;
+    size = info.st_size;
+}
+
+std::string ModelHandle::lastError()const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
+
+void ModelHandle::watch()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::chrono::milliseconds interval(static_cast<long long>(m_poll*1000));
+    while( !m_stop ){
+        m_wake.wait_for(lock, interval);
+        if( m_stop ) break;
+        long long time, size;
+        stamp(time, size);
+        bool changed;
+        {
+            std::lock_guard<std::mutex> plock(m_publish);
+            changed = size!=0 && (time!=m_time || size!=m_size);
+            if( changed ) { m_time = time; m_size = size; } // once per change, even if it fails
+        }
+        if( !changed ) continue;
+        lock.unlock();
+        std::string error;
+        try{
+            publish(readModel(m_filename));
+        }catch(const std::exception& e){
+            error = e.what();
+        }
+        lock.lock();
+        m_error = error;
+    }
+}
@@ -0,0 +1,83 @@
+/** @file  ModelSet.cpp
+    @brief implementation of class ModelSet
+
+    $Header$
+*/
+#include "classifier/ModelSet.h"
+#include "classifier/DecisionTree.h"
+#include "classifier/TrainingInfo.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+int ModelSet::position(const std::string& name)
+{
+    std::vector<std::string>::const_iterator it = std::find(m_vars.begin(), m_vars.end(), name);
+    if( it!=m_vars.end() ) return it-m_vars.begin();
+    m_vars.push_back(name);
+    return m_vars.size()-1;
+}
+
+unsigned int ModelSet::add(const DecisionTree& dtree, const std::vector<std::string>& vars)
+{
+    const CompiledTree& source = dtree.compiled();
+    if( source.width() > static_cast<int>(vars.size()) ) {
+        throw std::invalid_argument("ModelSet::add: tree uses more variables than given for "+dtree.title());
+    }
+    std::vector<int> map;
+    for( std::vector<std::string>::const_iterator it=vars.begin(); it!=vars.end(); ++it){
+        map.push_back(position(*it));
+    }
+
+    // copy each tree, with the indices changed, and the leaf outputs if several
+    CompiledTree model;
+    unsigned int outputs = source.outputs();
+    for( unsigned int tree=0; tree<source.treeCount(); ++tree){
+        const CompiledTree::Node* root = source.root(tree);
+        std::vector<CompiledTree::Node> nodes(root, root+source.treeSize(tree));
+        std::vector<double> values;
+        bool several = outputs>1 && source.tree(tree).weight > 0;
+        for( std::vector<CompiledTree::Node>::iterator it=nodes.begin(); it!=nodes.end(); ++it){
+            if( !it->isLeaf() ) { it->index = map[it->index]; continue; }
+            if( !several ) continue;
+            const double* v = source.outputs(*it);
+            it->child = values.size();
+            values.insert(values.end(), v, v+outputs);
+        }
+        if( several ) model.addTree(source.tree(tree).weight, nodes, std::vector<CompiledTree::Statistics>(), outputs, values);
+        else model.addTree(source.tree(tree).weight, nodes);
+    }
+    m_models.push_back(model);
+    m_titles.push_back(dtree.title());
+    return m_models.size()-1;
+}
+
+unsigned int ModelSet::add(const std::string& treeInfoFolder)
+{
+    std::string filename(treeInfoFolder+"/dtree.txt");
+    std::ifstream input(filename.c_str());
+    if( !input.is_open()) {
+        throw std::invalid_argument("ModelSet::add: could not open file '"+filename+"'");
+    }
+    DecisionTree dtree(input);
+    TrainingInfo info(treeInfoFolder);
+    return add(dtree, info.vars());
+}
+
+void ModelSet::evaluate(const float* row, double* scores)const
+{
+    for( unsigned int m=0; m<m_models.size(); ++m) scores[m] = m_models[m](row);
+}
+
+void ModelSet::evaluate(const float* rows, size_t count, size_t stride, double* scores)const
+{
+    // a block at a time, all the models, so that the rows stay in cache
+    const size_t block = CompiledTree::s_block;
+    for( size_t first=0; first<count; first+=block){
+        size_t n = std::min(block, count-first);
+        for( unsigned int m=0; m<m_models.size(); ++m){
+            m_models[m].evaluate(rows+first*stride, n, stride, scores+m*count+first);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/** @file  ParallelScorer.cpp
+    @brief implementation of class ParallelScorer
+
+    $Header$
+*/
+#include "classifier/ParallelScorer.h"
+#include "classifier/DecisionTree.h"
+
+#include <algorithm>
+
+size_t ParallelScorer::s_slice = 16*CompiledTree::s_block;
+
+namespace {
+    /// evaluate slice i of a row-major matrix
+    class RowSlices : public ThreadPool::Task {
+    public:
+        RowSlices(const CompiledTree& model, const float* rows, size_t count, size_t stride, double* scores)
+            : m_model(model), m_rows(rows), m_count(count), m_stride(stride), m_scores(scores){}
+        void operator()(unsigned int part)const
+        {
+            size_t first = part*ParallelScorer::s_slice,
+                n = std::min(ParallelScorer::s_slice, m_count-first);
+            m_model.evaluate(m_rows+first*m_stride, n, m_stride, m_scores+first);
+        }
+    private:
+        const CompiledTree& m_model;
+        const float* m_rows;
+        size_t m_count, m_stride;
+        double* m_scores;
+    };
+
+    /// evaluate slice i of a set of columns
+    class ColumnSlices : public ThreadPool::Task {
+    public:
+        ColumnSlices(const CompiledTree& model, const float* const* columns, size_t count, double* scores)
+            : m_model(model), m_columns(columns), m_count(count), m_scores(scores){}
+        void operator()(unsigned int part)const
+        {
+            size_t first = part*ParallelScorer::s_slice,
+                n = std::min(ParallelScorer::s_slice, m_count-first);
+            std::vector<const float*> columns(m_model.width()+1);
+            for( int j=0; j<m_model.width(); ++j) columns[j] = m_columns[j]+first;
+            m_model.evaluate(&columns[0], n, m_scores+first);
+        }
+    private:
+        const CompiledTree& m_model;
+        const float* const* m_columns;
+        size_t m_count;
+        double* m_scores;
+    };
+
+    unsigned int slices(size_t count)
+    {
+        return (count + ParallelScorer::s_slice-1)/ParallelScorer::s_slice;
+    }
+}
+
+ParallelScorer::ParallelScorer(const DecisionTree& dtree, unsigned int nthreads)
+: m_model(dtree.compiled())
+, m_pool(nthreads)
+{}
+
+ParallelScorer::ParallelScorer(const CompiledTree& model, unsigned int nthreads)
+: m_model(model)
+, m_pool(nthreads)
+{}
+
+void ParallelScorer::evaluate(const float* rows, size_t count, size_t stride, double* scores)const
+{
+    m_pool.run(slices(count), RowSlices(m_model, rows, count, stride, scores));
+}
+
+void ParallelScorer::evaluate(const float* const* columns, size_t count, double* scores)const
+{
+    m_pool.run(slices(count), ColumnSlices(m_model, columns, count, scores));
+}
@@ -0,0 +1,160 @@
+/** @file  QuickScorer.cpp
+    @brief implementation of class QuickScorer
+
+    $Header$
+*/
+#include "classifier/QuickScorer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+    typedef QuickScorer::Bits Bits;
+
+    /// bits 0 to n-1 set
+    Bits lowbits(unsigned int n){ return n>=64 ? ~Bits(0) : (Bits(1)<<n)-1; }
+
+    /// position of the lowest bit set
+    unsigned int lowest(Bits b)
+    {
+#ifdef __GNUC__
+        return __builtin_ctzll(b);
+#else
+        unsigned int n=0;
+        while( (b & 1)==0 ) { b>>=1; ++n; }
+        return n;
+#endif
+    }
+
+    /// a branch node, with the mask to apply if its test fails
+    struct Test {
+        int feature;
+        double cut;
+        unsigned int tree;
+        Bits mask;
+        bool operator<(const Test& other)const{
+            return feature!=other.feature ? feature < other.feature : cut < other.cut;
+        }
+    };
+
+    unsigned int countLeaves(const CompiledTree::Node* root, unsigned int node)
+    {
+        const CompiledTree::Node& n = root[node];
+        if( n.isLeaf() ) return 1;
+        return countLeaves(root, n.child) + countLeaves(root, n.child+1);
+    }
+
+    /// number the leaves of the subtree at node from left to right, and make the masks for its branch nodes
+    void number(const CompiledTree::Node* root, unsigned int node, unsigned int quick, 
+        unsigned int& leaf, std::vector<Test>& tests, std::vector<double>& leaves)
+    {
+        const CompiledTree::Node& n = root[node];
+        if( n.isLeaf() ){
+            leaves.push_back(n.value);
+            ++leaf;
+            return;
+        }
+        unsigned int first = leaf;
+        number(root, n.child, quick, leaf, tests, leaves);
+        // failing the test, going right, excludes the leaves of the left subtree
+        Test t;
+        t.feature = n.index;
+        t.cut = n.value;
+        t.tree = quick;
+        t.mask = ~(lowbits(leaf) & ~lowbits(first));
+        tests.push_back(t);
+        number(root, n.child+1, quick, leaf, tests, leaves);
+    }
+}
+
+QuickScorer::QuickScorer(const CompiledTree& model)
+: m_model(model)
+, m_quick_index(model.treeCount(), -1)
+{
+    std::vector<Test> tests;
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        if( model.tree(tree).weight <= 0 ) continue; // filters are walked
+        const CompiledTree::Node* root = model.root(tree);
+        unsigned int nleaves = countLeaves(root, 0);
+        if( nleaves > 64 ) continue; // too big for a bit vector
+        unsigned int quick = m_quick.size(), leaf=0;
+        m_quick_index[tree] = quick;
+        m_quick.push_back(tree);
+        m_initial.push_back(lowbits(nleaves));
+        m_leaf_offset.push_back(m_leaves.size());
+        number(root, 0, quick, leaf, tests, m_leaves);
+    }
+    std::stable_sort(tests.begin(), tests.end());
+
+    int nfeatures = tests.empty()? 0 : tests.back().feature+1;
+    m_feature_offset.assign(nfeatures+1, 0);
+    for( std::vector<Test>::const_iterator it=tests.begin(); it!=tests.end(); ++it){
+        m_feature_offset[it->feature+1]++;
+        m_cuts.push_back(it->cut);
+        m_trees.push_back(it->tree);
+        m_masks.push_back(it->mask);
+    }
+    for( int f=0; f<nfeatures; ++f) m_feature_offset[f+1] += m_feature_offset[f];
+}
+
+double QuickScorer::score(const float* row, Bits* bits)const
+{
+    // filters first: if one fails, nothing else to do
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        if( m_model.tree(tree).weight > 0 ) continue;
+        double value = m_model.evaluate(tree, row);
+        if( value == 0 ) return 0;
+        if( value != 1.0 ) {
+            throw std::runtime_error(
+                "QuickScorer: processing a filter, expect only 0 or 1 leaf nodes");
+        }
+    }
+
+    std::copy(m_initial.begin(), m_initial.end(), bits);
+    for( unsigned int f=0; f+1<m_feature_offset.size(); ++f){
+        unsigned int k = m_feature_offset[f], end = m_feature_offset[f+1];
+        if( k==end ) continue;
+        double x = row[f];
+        if( x != x ){
+            // NaN fails every test, as in the tree walk
+            for( ; k<end; ++k) bits[m_trees[k]] &= m_masks[k];
+        }else{
+            for( ; k<end && m_cuts[k] <= x; ++k) bits[m_trees[k]] &= m_masks[k];
+        }
+    }
+
+    // sum in tree order, so that the result is the same as CompiledTree::operator()
+    double weighted_sum=0, sum_of_weights=0;
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        double weight = m_model.tree(tree).weight;
+        if( weight <= 0 ) continue;
+        int quick = m_quick_index[tree];
+        double value = quick>=0 
+            ? m_leaves[m_leaf_offset[quick] + lowest(bits[quick])]
+            : m_model.evaluate(tree, row);
+        sum_of_weights += weight;
+        weighted_sum += weight * value;
+    }
+    return sum_of_weights != 0 ? weighted_sum/sum_of_weights : 1;
+}
+
+double QuickScorer::operator()(const float* row)const
+{
+    // on the stack, unless there are too many trees: no allocation for each event
+    const size_t local = 256;
+    if( m_quick.size() < local ){
+        Bits bits[local];
+        return score(row, bits);
+    }
+    std::vector<Bits> bits(m_quick.size()+1);
+    return score(row, &bits[0]);
+}
+
+void QuickScorer::evaluate(const float* rows, size_t count, size_t stride, double* scores)const
+{
+    std::vector<Bits> bits(m_quick.size()+1);
+    for( size_t i=0; i<count; ++i){
+        scores[i] = score(rows+i*stride, &bits[0]);
+    }
+}
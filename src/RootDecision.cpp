@@ -7,12 +7,14 @@
 */
 
 #include "classifier/RootDecision.h"
+#include "classifier/RootPrefetch.h"
 
 #include "classifier/DecisionTree.h"
 #include "classifier/TrainingInfo.h"
 
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
 
 RootDecision::RootDecision( RootTuple& tuple, 
         const std::string& treeInfoFolder, bool weighted)
@@ -33,6 +35,38 @@ RootDecision::~ RootDecision(){
     delete m_dtree;
 }
 
+void RootDecision::evaluate(unsigned int first, unsigned int count, 
+                            std::vector<std::pair<double,double> >& results)const
+{
+    const size_t block = CompiledTree::s_block;
+    bool weighted = m_tuple->weighted();
+    size_t size = m_tuple->size();
+    if( first>=size ) return;
+    size_t last = count > size-first ? size : first+count;
+    std::vector<float> rows;
+    std::vector<double> values(block);
+    // the next blocks are read while this one is evaluated
+    RootPrefetch blocks(*m_tuple, first, last, block);
+    while( const RootPrefetch::Block* b = blocks.next() ){
+        const std::vector<std::vector<float> >& columns = b->columns;
+        size_t n = b->count, width = columns.size();
+        rows.resize(n*width);
+        for( size_t j=0; j<width; ++j){
+            const float* column = &columns[j][0];
+            for( size_t k=0; k<n; ++k) rows[k*width+j] = column[k];
+        }
+        // if the tuple has weighted events, the first col is the weight
+        size_t skip = weighted? 1 : 0;
+        if( width-skip < static_cast<size_t>(m_dtree->compiled().width()) ) {
+            throw std::invalid_argument("RootDecision::evaluate: fewer columns than the variables the trees use");
+        }
+        m_dtree->evaluate(&rows[skip], n, width, &values[0]);
+        for( size_t k=0; k<n; ++k){
+            results.push_back(std::make_pair(values[k], weighted? rows[k*width] : 1.0));
+        }
+    }
+}
+
 RootDecision::Iterator::Iterator(const RootDecision* rd, bool end)
 : m_dtree(rd->dtree())
 , m_root_iterator(rd->tuple(), end)
@@ -49,13 +83,12 @@ RootDecision::Iterator::Iterator(const RootDecision* rd, unsigned int index)
 }
 std::pair<double, double>  RootDecision::Iterator::operator*()
 {
-    std::vector<float> row = *m_root_iterator;
+    const std::vector<float>& row = *m_root_iterator;
 
-    std::vector<float>::iterator icol=row.begin();
-    // if the tuple has weighted events, the first col is the weigth
-    double weight= (m_weighted)? *icol++ : 1.0;
-    std::vector<float> t(icol, row.end());
-    return std::make_pair( (*m_dtree)(t), weight);
+    // if the tuple has weighted events, the first col is the weight: evaluate the rest in place
+    size_t skip = m_weighted? 1 : 0;
+    double weight= (m_weighted)? row[0] : 1.0;
+    return std::make_pair( (*m_dtree)(&row[skip], row.size()-skip), weight);
 }
 
 RootDecision::Iterator& RootDecision::Iterator::operator++()
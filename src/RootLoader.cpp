@@ -7,12 +7,73 @@ $Header: /nfs/slac/g/glast/ground/cvs/classifier/src/RootLoader.cpp,v 1.1.1.1 20
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #include "classifier/RootLoader.h"
 #include "classifier/RootTuple.h"
+#include "classifier/RootPrefetch.h"
 #include "classifier/Classifier.h"
+#include "classifier/ThreadPool.h"
 #include "CLHEP/Random/RandFlat.h"
 
 #include <iomanip>
 #include <stdexcept>
 #include <iterator>
+#include <exception>
+#include <thread>
+
+unsigned int RootLoader::s_threads = 0;
+
+namespace {
+    /// the records of one file, and their count and sum of weights
+    struct Chunk {
+        Classifier::Table table;
+        double sum, count;
+        std::exception_ptr error; ///< kept, to report the first file in the list that failed
+    };
+
+    /// read each file, with its own RootTuple, into its chunk
+    class FileTask : public ThreadPool::Task {
+    public:
+        FileTask(const Classifier::StringList& files, const Classifier::StringList& names, bool use_weights,
+            bool signal, size_t step, const std::vector<size_t>& starts, std::vector<Chunk>& chunks, bool ahead)
+            : m_files(files), m_names(names), m_use_weights(use_weights), m_signal(signal)
+            , m_step(step), m_starts(starts), m_chunks(chunks), m_ahead(ahead){}
+
+        void operator()(unsigned int i)const
+        {
+            Chunk& chunk = m_chunks[i];
+            chunk.sum = chunk.count = 0;
+            try {
+                RootTuple t(m_files[i]+".root", "TopTree");
+                t.selectColumns(m_names, m_use_weights); 
+                // all the rows, or every other one, from the first or the second,
+                // the next blocks read while the records are made from the current one
+                size_t next = m_starts[i];
+                std::vector<float> row(m_names.size());
+                RootPrefetch blocks(t, 0, t.size(), 0, 0, m_ahead);
+                while( const RootPrefetch::Block* block = blocks.next() ){
+                    const std::vector<std::vector<float> >& columns = block->columns;
+                    size_t first = block->first;
+                    for( ; next<first+block->count; next+=m_step){
+                        for( size_t j=0; j<columns.size(); ++j) row[j] = columns[j][next-first];
+                        double weight = row[0]; // weight must be first column
+                        chunk.sum+= weight;
+                        ++chunk.count;
+                        // create a record with the signal or background weight
+                        chunk.table.push_back( Classifier::Record(m_signal, row));
+                    }
+                }
+            }catch(...){
+                chunk.error = std::current_exception();
+            }
+        }
+    private:
+        const Classifier::StringList& m_files;
+        const Classifier::StringList& m_names;
+        bool m_use_weights, m_signal;
+        size_t m_step;
+        const std::vector<size_t>& m_starts;
+        std::vector<Chunk>& m_chunks;
+        bool m_ahead; ///< each file read ahead by a thread of its own
+    };
+}
 
 RootLoader::RootLoader(
                        const Classifier::StringList & signal_files, 
@@ -63,34 +124,44 @@ void RootLoader::load(Classifier::Table& table,
 {
     double total_count=0, total_sum=0;
 
+    // the first row of each file, with the random choices made in file order, as before
+    size_t step = set==ALL? 1 : 2;
+    std::vector<size_t> starts(files.size(), 0);
+    for( size_t i=0; i<files.size(); ++i){
+        if( set==EVEN) starts[i] = 1;
+        if( set==RANDOM && m_rand->shoot()>0.5) starts[i] = 1; // skip first
+    }
 
-    for(Classifier::StringList::const_iterator i = files.begin(); i!=files.end(); ++i){
-        RootTuple t(*i+".root", "TopTree");
-        t.selectColumns(m_names, m_use_weights); 
-        double sum=0, count=0;
-        RootTuple::Iterator rit = t.begin();
-        if( set==EVEN) ++rit;
-	if( set==RANDOM && m_rand->shoot()>0.5) ++rit; // skip first
-        for( ; rit!=t.end(); ++rit){
-            const std::vector<float> & row = *rit;
-            double weight = row[0]; // weight must be first column
-            std::vector<float> rowx(row); // make a copy
-            sum+= weight;
-            ++count;
-            // create a record with the signal or background weight
-
-            table.push_back( Classifier::Record(signal, rowx));
-            // if doing alternate or random, skip the next record here.
-            if( set !=ALL || set==RANDOM && m_rand->shoot()>0.5 ){
-                ++rit; if( rit == t.end() )break;
-            }
+    // each file by a thread, which opens it
+    RootPrefetch::enableThreads();
+    std::vector<Chunk> chunks(files.size());
+    if( !files.empty() ){
+        // a file read ahead takes two threads: with just one, it is read in turn
+        unsigned int threads = s_threads>0? s_threads : std::thread::hardware_concurrency();
+        bool ahead = threads!=1;
+        unsigned int nthreads = threads>1? threads/2 : 1;
+        if( threads==0 || nthreads>files.size() ) nthreads = files.size();
+        ThreadPool pool(nthreads);
+        pool.run(files.size(), FileTask(files, m_names, m_use_weights, signal, step, starts, chunks, ahead));
+    }
 
-        }
-        log << std::setw(10) << (*i) 
-            << std::setw(6) << count 
-            << std::setw(10) << sum << std::endl;
-        total_count += count;
-        total_sum += sum;
+    // then join them in order
+    for( size_t i=0; i<files.size(); ++i){
+        if( chunks[i].error ) std::rethrow_exception(chunks[i].error);
+    }
+    size_t records=0;
+    for( size_t i=0; i<files.size(); ++i) records += chunks[i].table.size();
+    table.reserve(table.size()+records);
+    for( size_t i=0; i<files.size(); ++i){
+        Chunk& chunk = chunks[i];
+        table.insert(table.end(), std::make_move_iterator(chunk.table.begin()),
+            std::make_move_iterator(chunk.table.end()));
+        Classifier::Table().swap(chunk.table);
+        log << std::setw(10) << files[i] 
+            << std::setw(6) << chunk.count 
+            << std::setw(10) << chunk.sum << std::endl;
+        total_count += chunk.count;
+        total_sum += chunk.sum;
     }
     if( signal) m_signal_total = total_sum; 
     else        m_bkgnd_total=total_sum;
@@ -0,0 +1,121 @@
+/** @file  RootPrefetch.cpp
+    @brief implementation of class RootPrefetch
+
+    $Header$
+*/
+#include "classifier/RootPrefetch.h"
+#include "classifier/RootTuple.h"
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+# include "TROOT.h"
+#else
+# include "TThread.h"
+#endif
+
+#include <algorithm>
+
+namespace {
+    /// the ROOT call that allows it to be used by several threads
+    void initialize()
+    {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+        ROOT::EnableThreadSafety();
+#else
+        TThread::Initialize();
+#endif
+    }
+}
+
+size_t RootPrefetch::s_block_size = 4096;
+unsigned int RootPrefetch::s_depth = 3;
+
+RootPrefetch::RootPrefetch(const RootTuple& tuple, size_t first, size_t last,
+                           size_t block_size, unsigned int depth, bool ahead)
+: m_tuple(tuple)
+, m_first(first)
+, m_last(std::min(last, tuple.size()))
+, m_block_size(block_size>0? block_size : s_block_size)
+, m_ring(ahead? std::max(1u, depth>0? depth : s_depth) : 1)
+, m_read(0), m_used(0)
+, m_holding(false), m_done(false), m_stop(false)
+{
+    if( m_block_size==0 ) m_block_size = 1;
+    if( ahead ){
+        enableThreads();
+        m_thread = std::thread(&RootPrefetch::read, this);
+    }
+}
+
+void RootPrefetch::enableThreads()
+{
+    static std::once_flag once;
+    std::call_once(once, initialize);
+}
+
+RootPrefetch::~RootPrefetch()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_freed.notify_one();
+    if( m_thread.joinable() ) m_thread.join();
+}
+
+void RootPrefetch::read()
+{
+    try {
+        for( size_t first=m_first; first<m_last; first+=m_block_size){
+            Block* block;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while( !m_stop && m_read-m_used >= m_ring.size() ) m_freed.wait(lock);
+                if( m_stop ) break;
+                block = &m_ring[m_read % m_ring.size()];
+            }
+            // the slot is the reader's until it is counted as read
+            block->first = first;
+            block->count = m_tuple.fill_block(first, std::min(m_block_size, m_last-first), block->columns);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_read;
+            }
+            m_filled.notify_one();
+        }
+    }catch(...){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+    }
+    m_filled.notify_one();
+}
+
+const RootPrefetch::Block* RootPrefetch::next()
+{
+    if( !m_thread.joinable() ){
+        // no reader: the one block, read here
+        size_t first = m_first + m_read*m_block_size;
+        if( first>=m_last ) return 0;
+        Block& block = m_ring[0];
+        block.first = first;
+        block.count = m_tuple.fill_block(first, std::min(m_block_size, m_last-first), block.columns);
+        ++m_read;
+        return &block;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if( m_holding ){
+        ++m_used;
+        m_holding = false;
+        m_freed.notify_one();
+    }
+    while( m_read==m_used && !m_done ) m_filled.wait(lock);
+    if( m_read > m_used ){
+        m_holding = true;
+        return &m_ring[m_used % m_ring.size()];
+    }
+    if( m_error ) std::rethrow_exception(m_error);
+    return 0;
+}
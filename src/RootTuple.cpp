@@ -7,8 +7,19 @@ $Header: /nfs/slac/g/glast/ground/cvs/classifier/src/RootTuple.cpp,v 1.3 2005/07
 #include "TFile.h"
 #include "TTree.h"
 #include "TLeaf.h"
+#include "TBranch.h"
 #include "TSystem.h"
+#include "RVersion.h"
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,20,0)
+# define CLASSIFIER_BULK // whole baskets can be read with TBranch::GetBulkRead
+# include "TBufferFile.h"
+# include "Bytes.h"
+#endif
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #ifdef WIN32
@@ -51,6 +62,57 @@ namespace {
 #endif
     }
 
+    /// true if all the values are finite: no early exit, so that the loop is vectorized
+    bool allFinite(const float* values, size_t count)
+    {
+        bool bad = false;
+        for( size_t i=0; i<count; ++i) bad |= !(std::fabs(values[i]) <= FLT_MAX);
+        return !bad;
+    }
+
+    /// read a range of entries of one branch, converting the bound value to float
+    template<class T>
+    void readBranch(TBranch* branch, const T* buffer, Long64_t first, size_t count, float* out)
+    {
+        for( size_t i=0; i<count; ++i){
+            branch->GetEntry(first+i);
+            out[i] = static_cast<float>(static_cast<double>(*buffer)); // as TLeaf::GetValue
+        }
+    }
+
+#ifdef CLASSIFIER_BULK
+    /** @brief read a range of entries of one branch a basket at a time, with the bulk API
+        @return the number read: fewer than count if a basket cannot be read this way
+
+        Each basket comes serialized, as in the file, and is converted here, with no call per entry.
+    */
+    template<class T>
+    size_t readBulk(TBranch* branch, TBufferFile& buffer, Long64_t first, size_t count, float* out)
+    {
+        const Long64_t* starts = branch->GetBasketEntry();
+        int baskets = branch->GetWriteBasket();
+        size_t done=0;
+        while( done<count ){
+            Long64_t entry = first+done;
+            // the basket holding the entry, read from its start
+            const Long64_t* basket = std::upper_bound(starts, starts+baskets+1, entry);
+            if( basket==starts ) break;
+            Long64_t start = *(basket-1);
+            Int_t n = branch->GetBulkRead().GetEntriesSerialized(start, buffer);
+            if( n<=0 || start+n<=entry ) break;
+            char* data = buffer.GetCurrent() + (entry-start)*sizeof(T);
+            size_t k = std::min<size_t>(count-done, start+n-entry);
+            for( size_t i=0; i<k; ++i){
+                T value;
+                frombuf(data, &value);
+                out[done+i] = static_cast<float>(static_cast<double>(value)); // as TLeaf::GetValue
+            }
+            done += k;
+        }
+        return done;
+    }
+#endif
+
 }// anon namespace
 
 /** @class RootTuple::Entry
@@ -58,33 +120,130 @@ namespace {
 */
 class RootTuple::Entry {
 public:
-    Entry(TTree* tree, const std::string &name) {
-      m_leaf = tree->GetLeaf(name.c_str());
-      if( 0==m_leaf){
-	m_leaf = tree->GetLeaf(("_" + name).c_str());
-	if( 0==m_leaf) {
+    /// the types that can be bound to a buffer
+    typedef enum {OTHER, FLOAT, DOUBLE, INT, UINT, SHORT, USHORT, CHAR, UCHAR, LONG64, ULONG64, BOOL} Type;
+
+    Entry(TTree* tree, TLeaf* leaf) : m_leaf(leaf), m_type(OTHER), m_bulk(false)
+#ifdef CLASSIFIER_BULK
+      , m_serialized(TBuffer::kWrite, 32*1024)
+#endif
+    {
+      // make sure the branch containing this leaf is activated
+      TBranch* b = m_leaf->GetBranch();
+      tree->SetBranchStatus(b->GetName(),1);
+      m_branch = b;
+      bind(tree);
+    }
+    /// the leaf of a name, or with an underscore before it
+    static TLeaf* find(TTree* tree, const std::string &name)
+    {
+      TLeaf* leaf = tree->GetLeaf(name.c_str());
+      if( 0==leaf){
+	leaf = tree->GetLeaf(("_" + name).c_str());
+	if( 0==leaf) {
 	  tree->Print();
 	  throw std::invalid_argument(std::string("RootTuple::Entry: could not find leaf ")+name);
 	}
       }
-      // make sure the branch containing this leaf is activated
-      TBranch* b = m_leaf->GetBranch();
-      tree->SetBranchStatus(b->GetName(),1);
+      return leaf;
     }
     double operator()()const{return m_leaf->GetValue();}
     operator double ()const{return m_leaf->GetValue();}
+    TBranch* branch()const{return m_branch;}
+    TLeaf* leaf()const{return m_leaf;}
+
+    /// read a range of entries of this tree into out: whole baskets if possible, then an entry at a time
+    void read(Long64_t first, size_t count, float* out)
+    {
+        size_t done = bulk(first, count, out);
+        first += done; count -= done; out += done;
+        switch (m_type) {
+            case FLOAT:   readBranch(m_branch, &m_buffer.f, first, count, out); break;
+            case DOUBLE:  readBranch(m_branch, &m_buffer.d, first, count, out); break;
+            case INT:     readBranch(m_branch, &m_buffer.i, first, count, out); break;
+            case UINT:    readBranch(m_branch, &m_buffer.ui, first, count, out); break;
+            case SHORT:   readBranch(m_branch, &m_buffer.s, first, count, out); break;
+            case USHORT:  readBranch(m_branch, &m_buffer.us, first, count, out); break;
+            case CHAR:    readBranch(m_branch, &m_buffer.c, first, count, out); break;
+            case UCHAR:   readBranch(m_branch, &m_buffer.uc, first, count, out); break;
+            case LONG64:  readBranch(m_branch, &m_buffer.l, first, count, out); break;
+            case ULONG64: readBranch(m_branch, &m_buffer.ul, first, count, out); break;
+            case BOOL:    readBranch(m_branch, &m_buffer.b, first, count, out); break;
+            default:
+                for( size_t i=0; i<count; ++i){
+                    m_branch->GetEntry(first+i);
+                    out[i] = static_cast<float>(m_leaf->GetValue());
+                }
+        }
+    }
 private:
+    /// read with the bulk API, if the branch allows it: the number read
+    size_t bulk(Long64_t first, size_t count, float* out)
+    {
+#ifdef CLASSIFIER_BULK
+        if( !m_bulk ) return 0;
+        switch (m_type) {
+            case FLOAT:   return readBulk<Float_t>(m_branch, m_serialized, first, count, out);
+            case DOUBLE:  return readBulk<Double_t>(m_branch, m_serialized, first, count, out);
+            case INT:     return readBulk<Int_t>(m_branch, m_serialized, first, count, out);
+            case UINT:    return readBulk<UInt_t>(m_branch, m_serialized, first, count, out);
+            case SHORT:   return readBulk<Short_t>(m_branch, m_serialized, first, count, out);
+            case USHORT:  return readBulk<UShort_t>(m_branch, m_serialized, first, count, out);
+            case CHAR:    return readBulk<Char_t>(m_branch, m_serialized, first, count, out);
+            case UCHAR:   return readBulk<UChar_t>(m_branch, m_serialized, first, count, out);
+            case LONG64:  return readBulk<Long64_t>(m_branch, m_serialized, first, count, out);
+            case ULONG64: return readBulk<ULong64_t>(m_branch, m_serialized, first, count, out);
+            case BOOL:    return readBulk<Bool_t>(m_branch, m_serialized, first, count, out);
+            default:      return 0;
+        }
+#else
+        (void)first; (void)count; (void)out;
+        return 0;
+#endif
+    }
+
+    /// bind the buffer to the branch, if it holds a single value of a known type
+    void bind(TTree* tree)
+    {
+        if( m_branch->GetNleaves()!=1 || m_leaf->GetLen()!=1 || m_leaf->GetLeafCount()!=0 ) return;
+        static const char* names[] = {"", "Float_t", "Double_t", "Int_t", "UInt_t", "Short_t", "UShort_t",
+            "Char_t", "UChar_t", "Long64_t", "ULong64_t", "Bool_t"};
+        const char* type = m_leaf->GetTypeName();
+        for( int k=FLOAT; k<=BOOL && type!=0; ++k){
+            if( std::strcmp(type, names[k])!=0 ) continue;
+            std::memset(&m_buffer, 0, sizeof(m_buffer));
+            if( tree->SetBranchAddress(m_branch->GetName(), &m_buffer)>=0 ) m_type = static_cast<Type>(k);
+#ifdef CLASSIFIER_BULK
+            m_bulk = m_type!=OTHER && m_branch->SupportsBulkRead();
+#endif
+            return;
+        }
+    }
+
     TLeaf* m_leaf;
+    TBranch* m_branch;
+    Type m_type;
+    bool m_bulk;          ///< whole baskets can be read
+#ifdef CLASSIFIER_BULK
+    TBufferFile m_serialized; ///< a basket, as read by the bulk API
+#endif
+    /// the value of the current entry, if bound
+    union {
+        float f; double d; int i; unsigned int ui; short s; unsigned short us;
+        char c; unsigned char uc; long long l; unsigned long long ul; bool b;
+    } m_buffer;
 };
 
+long long RootTuple::s_cache_size = 30000000;
+
 RootTuple::RootTuple(std::string root_file, std::string tree_name)
-: m_total_size(0)
+: m_total_size(0), m_cache_first(0), m_cache_last(0)
 {
     add(root_file, tree_name);
 }
 
 RootTuple::RootTuple(std::vector<std::string> root_files, std::string tree_name)
-: m_total_size(0)
+: m_total_size(0), m_cache_first(0), m_cache_last(0)
 {
 #ifdef WIN32 // ROOT work-around
     static bool first=true;
@@ -100,17 +259,15 @@ RootTuple::RootTuple(std::vector<std::string> root_files, std::string tree_name)
 
 inline static void do_load (void)
 {
-    static bool first = true;
-    if( first) {
-      gSystem->Load("libTree");
-      first=false;
-    }
+    // once, even if tuples are made by several threads: see RootLoader
+    static const int loaded = gSystem->Load("libTree");
+    (void)loaded;
 }
 
 void RootTuple::add(std::string root_file, std::string tree_name)
 {
   do_load();
-    std::cout << "Opening " << root_file << std::endl;
+    std::cout << ("Opening " + root_file + "\n") << std::flush; // one write: files may be opened in parallel
     TFile* f = new TFile(root_file.c_str(), "READ");
     if( ! f->IsOpen()) throw std::invalid_argument(std::string(
         "RootTuple: could not open file ")+root_file);
@@ -120,7 +277,7 @@ void RootTuple::add(std::string root_file, std::string tree_name)
 }
 
 RootTuple::RootTuple (TTree *t)
-: m_total_size(0)
+: m_total_size(0), m_cache_first(0), m_cache_last(0)
 {
   do_load();
   add (t);
@@ -149,13 +306,29 @@ void RootTuple::selectColumns(const std::vector<std::string>& names, bool weight
         "RootTuple::selectColumns: no names in selection");
     m_weighted = weighted;
     m_entries.clear();
+    m_cache_first = m_cache_last = 0;
     for( std::vector<TTree*>::iterator tit = m_trees.begin(); tit!=m_trees.end(); ++tit){
         TTree* tree = *tit;
         tree->SetBranchStatus("*",0);  // default all branches off -- Entry will active what it needs
         m_entries.push_back(EntryList());
         std::vector<std::string>::const_iterator nit = names.begin();
         for( ; nit!=names.end(); ++nit){
-            m_entries.back().push_back(new Entry( tree, *nit));
+            // a leaf named again shares its entry: a second one would bind the branch to its
+            // own buffer, and the first would read nothing
+            TLeaf* leaf = Entry::find(tree, *nit);
+            Entry* entry = 0;
+            for( EntryList::const_iterator et=m_entries.back().begin(); et!=m_entries.back().end(); ++et){
+                if( (*et)->leaf()==leaf ) entry = *et;
+            }
+            if( entry==0 ) entry = new Entry( tree, leaf);
+            m_entries.back().push_back(entry);
+        }
+        // the cache reads just these branches, without learning them from the first entries
+        tree->SetCacheSize(s_cache_size);
+        if( s_cache_size>0 ){
+            EntryList::const_iterator et=m_entries.back().begin();
+            for( ; et!=m_entries.back().end(); ++et) tree->AddBranchToCache((*et)->branch(), true);
+            tree->StopCacheLearningPhase();
         }
     }
 }
@@ -187,6 +360,60 @@ void RootTuple::fill_row(int event, std::vector<float>& row )const
     }
 }
 
+size_t RootTuple::fill_block(size_t first, size_t count, std::vector<std::vector<float> >& columns)const
+{
+    size_t n = first<m_total_size? std::min(count, m_total_size-first) : 0;
+    size_t ncol = m_entries.empty()? 0 : m_entries[0].size();
+    columns.resize(ncol);
+    for( size_t j=0; j<ncol; ++j) columns[j].resize(n);
+
+    // the cache fills the clusters from here to the end: set again only when reading elsewhere,
+    // as setting the range empties it
+    if( s_cache_size>0 && n>0 && (first<m_cache_first || first+n>m_cache_last) ){
+        m_cache_first = first;
+        m_cache_last = m_total_size;
+        for( size_t i=0; i<m_trees.size(); ++i){
+            size_t start = i>0? m_sizes[i-1] : 0;
+            if( m_sizes[i] <= first ) continue;
+            m_trees[i]->SetCacheEntryRange(first>start? first-start : 0, m_sizes[i]-start);
+        }
+    }
+
+    // the trees that the range covers, each a column at a time
+    size_t done=0;
+    for( size_t i=0; i<m_trees.size() && done<n; ++i){
+        size_t start = i>0? m_sizes[i-1] : 0;
+        if( first+done >= m_sizes[i] ) continue;
+        TTree* tree = m_trees[i];
+        Long64_t local = first+done-start, end = local + std::min(n-done, m_sizes[i]-(first+done));
+        // with a cache, a cluster at a time: it fills from the entry loaded, which reading
+        // a branch alone does not set
+        TTree::TClusterIterator clusters = tree->GetClusterIterator(local);
+        while( local<end ){
+            Long64_t next = end;
+            if( s_cache_size>0 ){
+                clusters();
+                next = std::max(local+1, std::min(end, clusters.GetNextEntry()));
+                tree->LoadTree(local);
+            }
+            for( size_t j=0; j<ncol; ++j){
+                size_t same = std::find(m_entries[i].begin(), m_entries[i].begin()+j, m_entries[i][j]) - m_entries[i].begin();
+                float* out = &columns[j][done];
+                if( same<j ) std::copy(&columns[same][done], &columns[same][done]+(next-local), out); // named twice
+                else m_entries[i][j]->read(local, static_cast<size_t>(next-local), out);
+            }
+            done += static_cast<size_t>(next-local);
+            local = next;
+        }
+    }
+    for( size_t j=0; j<ncol; ++j){
+        if( n>0 && !allFinite(&columns[j][0], n) ) {
+            throw std::runtime_error("RootTuple::fill_block: Nan found in input");
+        }
+    }
+    return n;
+}
+
 size_t RootTuple::size()const
 { 
     return m_total_size;
@@ -0,0 +1,79 @@
+/** @file  ThreadPool.cpp
+    @brief implementation of class ThreadPool
+
+    $Header$
+*/
+#include "classifier/ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int nthreads)
+: m_task(0)
+, m_count(0), m_next(0), m_pending(0)
+, m_generation(0)
+, m_stop(false)
+{
+    if( nthreads==0 ) nthreads = std::thread::hardware_concurrency();
+    for( unsigned int t=1; t<nthreads; ++t){
+        m_threads.push_back(std::thread(&ThreadPool::work, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for( size_t t=0; t<m_threads.size(); ++t) m_threads[t].join();
+}
+
+void ThreadPool::work()
+{
+    unsigned long seen=0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(;;){
+        while( !m_stop && m_generation==seen ) m_start.wait(lock);
+        if( m_stop ) return;
+        seen = m_generation;
+        drain(lock);
+    }
+}
+
+void ThreadPool::drain(std::unique_lock<std::mutex>& lock)
+{
+    while( m_next < m_count ){
+        unsigned int part = m_next++;
+        lock.unlock();
+        try {
+            (*m_task)(part);
+        }catch(...){
+            lock.lock();
+            if( !m_error ) m_error = std::current_exception();
+            lock.unlock();
+        }
+        lock.lock();
+        if( --m_pending == 0 ) m_done.notify_all();
+    }
+}
+
+void ThreadPool::run(unsigned int count, const Task& task)
+{
+    std::lock_guard<std::mutex> serial(m_run);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_count = count;
+    m_next = 0;
+    m_pending = count;
+    ++m_generation;
+    m_start.notify_all();
+
+    drain(lock);
+    while( m_pending > 0 ) m_done.wait(lock);
+    m_task = 0;
+    if( m_error ){
+        std::exception_ptr error = m_error;
+        m_error = std::exception_ptr();
+        lock.unlock();
+        std::rethrow_exception(error);
+    }
+}
@@ -12,12 +12,15 @@
 #include "classifier/BackgroundVsEfficiency.h"
 #include "classifier/AdaBoost.h"
 #include "classifier/DecisionTree.h"
+#include "classifier/VariableScreen.h"
+#include "classifier/TreeExplainer.h"
 #include <string>
 #include <vector>
 #include <fstream>
 #include <iterator>
 
 int Trainer::s_boost=0; // set bootsing 
+int Trainer::s_screen=0; // no screening
 
 Trainer::Trainer( const TrainingInfo& info, std::ostream& mylog,
                  RootLoader::Subset trainingset, 
@@ -45,6 +48,15 @@ Trainer::Trainer( const TrainingInfo& info, std::ostream& mylog,
         m_signal_total=2.* loader.total(true);
         m_bkgnd_total=2.* loader.total(false);
 
+        // optionally rate the variables one at a time, and train only with the best
+        if( s_screen>0 ){
+            VariableScreen screen(training);
+            Classifier::Node::setActive(screen.select(s_screen, info.forcedVars()));
+            screen.print(log());
+        }else{
+            Classifier::Node::setActive(std::vector<int>());
+        }
+
         // create Classifier object with the training sample
         Classifier classify(training);
         classify.makeTree(true);
@@ -85,6 +97,9 @@ Trainer::Trainer( const TrainingInfo& info, std::ostream& mylog,
                 boostedtree = classify.createTree(info.title(),boostwt);
                 m_dtree->addTree(boostedtree);
             }
+            // rate the variables with all the boosted trees, not only the first
+            TreeExplainer(*m_dtree).importance(m_ratings);
+            m_ratings.resize(Classifier::Record::size(), 0.);
         }
 
         if(! info.filepath().empty()){
@@ -40,6 +40,9 @@ TrainerApplication::TrainerApplication(const std::string& datapath, const std::s
         }else{
             std::cout << "boosting " << Trainer::s_boost << " times" << std::endl;
         }
+        if( Trainer::s_screen>0){
+            std::cout << "screening variables: keep best " << Trainer::s_screen << std::endl;
+        }
 
         std::ifstream casefile( (outputpath+"/cases.txt").c_str() );
         if( !casefile.is_open() ){
@@ -91,9 +91,11 @@ TrainingInfo::TrainingInfo( const std::string& title,  const std::string& varstr
                 continue;
             }
             std::stringstream str(buf);
-            std::string name;
-            str >> name;
+            std::string name, flag;
+            str >> name >> flag;
             
             if( ! name.empty()) output.push_back(name);
+            // optional flag following the name
+            if( flag=="forced") m_forced.push_back(name);
         }
     }
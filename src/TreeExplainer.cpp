@@ -0,0 +1,244 @@
+/** @file  TreeExplainer.cpp
+    @brief implementation of class TreeExplainer
+
+    $Header$
+*/
+#include "classifier/TreeExplainer.h"
+#include "classifier/DecisionTree.h"
+#include "classifier/ThreadPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    /// the fraction of the training events at a branch that go to a child
+    double fraction(const CompiledTree::Statistics* statistics, unsigned int child, unsigned int other)
+    {
+        double a = statistics[child].cover, b = statistics[other].cover;
+        return a+b > 0 ? a/(a+b) : 0.5;
+    }
+
+    /// mean leaf value, weighted by the cover
+    double expectedValue(const CompiledTree::Node* root, const CompiledTree::Statistics* statistics,
+        unsigned int position)
+    {
+        const CompiledTree::Node& node = root[position];
+        if( node.isLeaf() ) return node.value;
+        return fraction(statistics, node.child, node.child+1) * expectedValue(root, statistics, node.child)
+            + fraction(statistics, node.child+1, node.child) * expectedValue(root, statistics, node.child+1);
+    }
+
+    /// number of branches on the longest path
+    unsigned int depthOf(const CompiledTree::Node* root, unsigned int position)
+    {
+        const CompiledTree::Node& node = root[position];
+        if( node.isLeaf() ) return 0;
+        return 1 + std::max(depthOf(root, node.child), depthOf(root, node.child+1));
+    }
+}
+
+TreeExplainer::TreeExplainer(const CompiledTree& model)
+: m_model(model)
+{
+    setup();
+}
+
+TreeExplainer::TreeExplainer(const DecisionTree& dtree)
+: m_model(dtree.compiled())
+{
+    setup();
+}
+
+void TreeExplainer::setup()
+{
+    if( !m_model.hasStatistics() ) {
+        throw std::invalid_argument("TreeExplainer: the model does not have the training statistics of its nodes");
+    }
+    m_sum_of_weights = 0;
+    m_depth = 0;
+    double weighted_sum = 0;
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        double weight = m_model.tree(tree).weight;
+        if( weight <= 0 ) continue;
+        m_sum_of_weights += weight;
+        weighted_sum += weight * expectedValue(m_model.root(tree), m_model.statistics(tree), 0);
+        m_depth = std::max(m_depth, depthOf(m_model.root(tree), 0));
+    }
+    // as the evaluation: with no trees, the value is 1
+    m_expected = m_sum_of_weights != 0 ? weighted_sum/m_sum_of_weights : 1;
+}
+
+void TreeExplainer::importance(std::vector<double>& ratings)const
+{
+    ratings.assign(m_model.width(), 0.);
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        double weight = m_model.tree(tree).weight;
+        if( weight <= 0 ) continue;
+        const CompiledTree::Node* root = m_model.root(tree);
+        const CompiledTree::Statistics* statistics = m_model.statistics(tree);
+        for( size_t k=0; k<m_model.treeSize(tree); ++k){
+            if( root[k].isLeaf() ) continue;
+            ratings[root[k].index] += weight/m_sum_of_weights * statistics[k].gain;
+        }
+    }
+}
+
+double TreeExplainer::explain(const float* row, double* phi)const
+{
+    std::fill(phi, phi+width(), 0.);
+    // an event rejected by a filter has the value 0: nothing to attribute
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        if( m_model.tree(tree).weight > 0 ) continue;
+        double value = m_model.evaluate(tree, row);
+        if( value == 0 ) return 0;
+        if( value != 1.0 ) {
+            throw std::runtime_error("TreeExplainer: processing a filter, expect only 0 or 1 leaf nodes");
+        }
+    }
+    // the paths of all the levels of the recursion, each one longer than its parent's
+    unsigned int max_depth = m_depth+2;
+    std::vector<PathElement> paths(max_depth*(max_depth+1)/2);
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        double weight = m_model.tree(tree).weight;
+        if( weight <= 0 ) continue;
+        explainTree(tree, row, weight/m_sum_of_weights, phi, paths);
+    }
+    return m_expected;
+}
+
+namespace {
+    class ExplainTask : public ThreadPool::Task {
+    public:
+        ExplainTask(const TreeExplainer& explainer, const float* rows, size_t count, size_t stride,
+            double* phi, size_t block)
+            : m_explainer(explainer), m_rows(rows), m_count(count), m_stride(stride), m_phi(phi), m_block(block){}
+        void operator()(unsigned int part)const
+        {
+            size_t width = m_explainer.width()+1;
+            for( size_t i=part*m_block; i<m_count && i<(part+1)*m_block; ++i){
+                m_phi[i*width+width-1] = m_explainer.explain(m_rows+i*m_stride, m_phi+i*width);
+            }
+        }
+    private:
+        const TreeExplainer& m_explainer;
+        const float* m_rows;
+        size_t m_count, m_stride;
+        double* m_phi;
+        size_t m_block;
+    };
+}
+
+void TreeExplainer::explain(const float* rows, size_t count, size_t stride, double* phi, unsigned int nthreads)const
+{
+    const size_t block = 64;
+    ExplainTask task(*this, rows, count, stride, phi, block);
+    unsigned int parts = (count+block-1)/block;
+    if( nthreads==1 || parts<2 ){
+        for( unsigned int part=0; part<parts; ++part) task(part);
+        return;
+    }
+    ThreadPool pool(nthreads);
+    pool.run(parts, task);
+}
+
+namespace {
+    /// add a step to the path, and update the weights of the subsets of each size
+    template<class E>
+    void extend(E* path, unsigned int depth, double zero_fraction, double one_fraction, int index)
+    {
+        path[depth].index = index;
+        path[depth].zero_fraction = zero_fraction;
+        path[depth].one_fraction = one_fraction;
+        path[depth].weight = depth==0 ? 1 : 0;
+        for( int i=depth-1; i>=0; --i){
+            path[i+1].weight += one_fraction * path[i].weight * (i+1) / (depth+1);
+            path[i].weight = zero_fraction * path[i].weight * (depth-i) / (depth+1);
+        }
+    }
+
+    /// undo extend for the step at position k
+    template<class E>
+    void unwind(E* path, unsigned int depth, unsigned int k)
+    {
+        double one_fraction = path[k].one_fraction, zero_fraction = path[k].zero_fraction;
+        double next = path[depth].weight;
+        for( int i=depth-1; i>=0; --i){
+            if( one_fraction != 0 ){
+                double w = path[i].weight;
+                path[i].weight = next * (depth+1) / ((i+1) * one_fraction);
+                next = w - path[i].weight * zero_fraction * (depth-i) / (depth+1);
+            }else{
+                path[i].weight = path[i].weight * (depth+1) / (zero_fraction * (depth-i));
+            }
+        }
+        for( unsigned int i=k; i<depth; ++i){
+            path[i].index = path[i+1].index;
+            path[i].zero_fraction = path[i+1].zero_fraction;
+            path[i].one_fraction = path[i+1].one_fraction;
+        }
+    }
+
+    /// the total weight the path would have, with the step at position k undone
+    template<class E>
+    double unwoundSum(const E* path, unsigned int depth, unsigned int k)
+    {
+        double one_fraction = path[k].one_fraction, zero_fraction = path[k].zero_fraction;
+        double next = path[depth].weight, total = 0;
+        for( int i=depth-1; i>=0; --i){
+            if( one_fraction != 0 ){
+                double w = next * (depth+1) / ((i+1) * one_fraction);
+                total += w;
+                next = path[i].weight - w * zero_fraction * (depth-i) / (depth+1);
+            }else if( zero_fraction != 0 ){
+                total += path[i].weight / zero_fraction * (depth+1) / (depth-i);
+            }
+        }
+        return total;
+    }
+}
+
+void TreeExplainer::explainTree(unsigned int tree, const float* row, double scale, double* phi,
+                                std::vector<PathElement>& paths)const
+{
+    recurse(tree, 0, row, scale, phi, &paths[0], 0, 1, 1, -1);
+}
+
+void TreeExplainer::recurse(unsigned int tree, unsigned int position, const float* row, double scale, double* phi,
+    PathElement* parent_path, unsigned int depth, double zero_fraction, double one_fraction, int index)const
+{
+    // this level's copy of the path, after the parent's
+    PathElement* path = parent_path + depth + 1;
+    std::copy(parent_path, parent_path+depth+1, path);
+    extend(path, depth, zero_fraction, one_fraction, index);
+
+    const CompiledTree::Node* root = m_model.root(tree);
+    const CompiledTree::Node& node = root[position];
+    if( node.isLeaf() ){
+        for( unsigned int i=1; i<=depth; ++i){
+            const PathElement& step = path[i];
+            phi[step.index] += unwoundSum(path, depth, i) * (step.one_fraction - step.zero_fraction)
+                * node.value * scale;
+        }
+        return;
+    }
+
+    // the child the event takes, as in the evaluation, and the other
+    const CompiledTree::Statistics* statistics = m_model.statistics(tree);
+    unsigned int hot = node.child + (row[node.index] < node.value ? 0 : 1),
+        cold = hot==node.child ? node.child+1 : node.child;
+    double incoming_zero = 1, incoming_one = 1;
+
+    // a variable tested before on this path: undo that step, and carry its fractions
+    unsigned int k=1;
+    while( k<=depth && path[k].index!=node.index ) ++k;
+    if( k<=depth ){
+        incoming_zero = path[k].zero_fraction;
+        incoming_one = path[k].one_fraction;
+        unwind(path, depth, k);
+        --depth;
+    }
+    recurse(tree, hot, row, scale, phi, path, depth+1,
+        fraction(statistics, hot, cold) * incoming_zero, incoming_one, node.index);
+    recurse(tree, cold, row, scale, phi, path, depth+1,
+        fraction(statistics, cold, hot) * incoming_zero, 0, node.index);
+}
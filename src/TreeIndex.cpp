@@ -0,0 +1,182 @@
+/** @file  TreeIndex.cpp
+    @brief implementation of class TreeIndex
+
+    $Header$
+*/
+#include "classifier/TreeIndex.h"
+#include "classifier/TreeReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <thread>
+#include <sys/stat.h>
+#ifdef WIN32
+# include <process.h>
+# define getpid _getpid
+#else
+# include <unistd.h>
+#endif
+
+const int TreeIndex::s_version;
+
+namespace {
+    /// bytes at each end of the text file included in its hash
+    const size_t hashed = 4096;
+
+    /// FNV-1a of the bytes
+    unsigned long long hash(const char* data, size_t length, unsigned long long h)
+    {
+        for( size_t k=0; k<length; ++k) h = (h ^ static_cast<unsigned char>(data[k])) * 1099511628211ULL;
+        return h;
+    }
+}
+
+TreeIndex::TreeIndex(const std::string& filename)
+: m_filename(filename)
+, m_size(0)
+, m_time(0)
+, m_hash(0)
+{
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+    if( !in.is_open() ) throw std::runtime_error("TreeIndex: could not open "+filename);
+    std::getline(in, m_title);
+    if( !m_title.empty() && m_title[m_title.size()-1]=='\r' ) m_title.erase(m_title.size()-1);
+    in.clear();
+    in.seekg(0, std::ios::end);
+    Stamp stamp;
+    stamp.size = static_cast<size_t>(in.tellg());
+
+    // a file rewritten with the same size, for example after training again, has other bytes at one end
+    std::string ends(std::min(stamp.size, 2*hashed), '\0');
+    size_t head = std::min(stamp.size, hashed);
+    in.seekg(0);
+    in.read(&ends[0], head);
+    in.seekg(stamp.size-(ends.size()-head));
+    in.read(&ends[head], ends.size()-head);
+    stamp.hash = hash(ends.data(), ends.size(), 14695981039346656037ULL);
+    in.close();
+    struct stat info;
+    stamp.time = stat(filename.c_str(), &info)==0? static_cast<long long>(info.st_mtime) : 0;
+
+    if( !load(stamp) ) build(stamp);
+}
+
+bool TreeIndex::load(const Stamp& stamp)
+{
+    std::ifstream in(indexName(m_filename).c_str());
+    if( !in.is_open() ) return false;
+    std::string word1, word2;
+    int version;
+    size_t count;
+    in >> word1 >> word2 >> version >> m_size >> m_time >> m_hash >> count;
+    if( !in || word1!="DecisionTree" || word2!="index" || version!=s_version
+        || m_size!=stamp.size || m_time!=stamp.time || m_hash!=stamp.hash ) return false;
+    size_t size = m_size;
+    m_trees.resize(count);
+    for( size_t i=0; i<count; ++i){
+        Entry& e = m_trees[i];
+        in >> e.offset >> e.line >> e.weight;
+        // each line whole: a number cut short at the end would still be read
+        if( !in || in.get()!='\n' || e.offset>=size || (i>0 && e.offset<=m_trees[i-1].offset) ) {
+            m_trees.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void TreeIndex::build(const Stamp& stamp)
+{
+    std::ifstream in(m_filename.c_str(), std::ios::in | std::ios::binary);
+    TreeReader reader(in); // only finds the trees: they are not converted
+    size_t size = stamp.size;
+    m_size = size;
+    m_time = stamp.time;
+    m_hash = stamp.hash;
+    m_trees.resize(reader.treeCount());
+    size_t title = size - reader.size(); // the title line, with its end
+    for( unsigned int tree=0; tree<reader.treeCount(); ++tree){
+        Entry& e = m_trees[tree];
+        e.offset = title + reader.offset(tree);
+        e.line = reader.line(tree);
+        e.weight = reader.weight(tree);
+    }
+
+    // save it for next time, if possible. Other jobs may be reading the index: write a file of
+    // this process and thread, and rename it into place, so that a reader never sees part of one
+    std::string name = indexName(m_filename);
+    std::ostringstream temporary;
+    temporary << name << "." << getpid() << "." << std::this_thread::get_id();
+    {
+        std::ofstream out(temporary.str().c_str());
+        if( !out.is_open() ) return;
+        out.precision(17);
+        out << "DecisionTree index " << s_version << " " << m_size << " " << m_time << " " << m_hash
+            << " " << m_trees.size() << "\n";
+        for( std::vector<Entry>::const_iterator it=m_trees.begin(); it!=m_trees.end(); ++it){
+            out << it->offset << "\t" << it->line << "\t" << it->weight << "\n";
+        }
+        out.close();
+        if( !out ) { std::remove(temporary.str().c_str()); return; }
+    }
+#ifdef WIN32
+    std::remove(name.c_str()); // rename does not replace a file here
+#endif
+    if( std::rename(temporary.str().c_str(), name.c_str())!=0 ) std::remove(temporary.str().c_str());
+}
+
+std::vector<unsigned int> TreeIndex::select(unsigned int tree_count)const
+{
+    std::vector<unsigned int> trees;
+    unsigned int used=0;
+    for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+        if( m_trees[tree].weight > 0 ){
+            if( tree_count>0 && used==tree_count ) continue; // only filters from now on
+            ++used;
+        }
+        trees.push_back(tree);
+    }
+    return trees;
+}
+
+std::vector<unsigned int> TreeIndex::filters()const
+{
+    std::vector<unsigned int> trees;
+    for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+        if( m_trees[tree].weight <= 0 ) trees.push_back(tree);
+    }
+    return trees;
+}
+
+void TreeIndex::read(CompiledTree& model, const std::vector<unsigned int>& trees, unsigned int nthreads)const
+{
+    for( size_t k=0; k<trees.size(); ++k){
+        if( trees[k]>=m_trees.size() || (k>0 && trees[k]<=trees[k-1]) ) {
+            throw std::invalid_argument("TreeIndex::read: trees out of range or not in order");
+        }
+    }
+    std::ifstream in(m_filename.c_str(), std::ios::in | std::ios::binary);
+    if( !in.is_open() ) throw std::runtime_error("TreeIndex::read: could not open "+m_filename);
+
+    // each run of consecutive trees is one read
+    TreeReader reader(m_title);
+    std::string text;
+    for( size_t k=0; k<trees.size(); ){
+        size_t run=1;
+        while( k+run<trees.size() && trees[k+run]==trees[k]+run ) ++run;
+        unsigned int last = trees[k+run-1];
+        size_t begin = m_trees[trees[k]].offset,
+            end = last+1<m_trees.size()? m_trees[last+1].offset : m_size;
+        text.resize(end-begin);
+        in.seekg(begin);
+        in.read(&text[0], text.size());
+        if( !in || reader.append(text, m_trees[trees[k]].line)!=run ) {
+            throw std::runtime_error("TreeIndex::read: "+indexName(m_filename)+" does not match the file");
+        }
+        k += run;
+    }
+    reader.read(model, nthreads);
+}
@@ -0,0 +1,140 @@
+/** @file  TreeProfile.cpp
+    @brief implementation of class TreeProfile
+
+    $Header$
+*/
+#include "classifier/TreeProfile.h"
+#include "classifier/DecisionTree.h"
+
+#include <atomic>
+#include <set>
+
+namespace {
+    std::atomic<unsigned long> next_id(0);
+
+    /// the ids of the profiles not yet deleted
+    std::mutex live_mutex;
+    std::set<unsigned long> live;
+}
+
+TreeProfile::TreeProfile(const DecisionTree& dtree)
+: m_model(dtree.compiled())
+, m_title(dtree.title())
+, m_id(++next_id)
+, m_visits(m_model.size()+1)
+, m_events(0)
+{
+    std::lock_guard<std::mutex> lock(live_mutex);
+    live.insert(m_id);
+}
+
+TreeProfile::~TreeProfile()
+{
+    {
+        std::lock_guard<std::mutex> lock(live_mutex);
+        live.erase(m_id);
+    }
+    table().erase(m_id); // the other threads drop theirs when they next make counters
+    for( size_t t=0; t<m_threads.size(); ++t) delete m_threads[t];
+}
+
+TreeProfile::Table& TreeProfile::table()
+{
+    static thread_local Table mine;
+    return mine;
+}
+
+TreeProfile::Counters& TreeProfile::counters()const
+{
+    // each thread finds its counters for this profile by id, which is never reused
+    Table& table = TreeProfile::table();
+    Counters*& local = table[m_id];
+    if( local==0 ){
+        {
+            // drop the entries of deleted profiles, so that the table does not grow without end
+            std::lock_guard<std::mutex> lock(live_mutex);
+            for( Table::iterator it=table.begin(); it!=table.end(); ){
+                if( it->first!=m_id && live.count(it->first)==0 ) table.erase(it++);
+                else ++it;
+            }
+        }
+        local = new Counters;
+        local->visits.assign(m_model.size()+1, 0);
+        local->events = 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threads.push_back(local);
+    }
+    return *local;
+}
+
+void TreeProfile::evaluate(const float* rows, size_t count, size_t stride, double* scores)const
+{
+    for( size_t i=0; i<count; ++i) scores[i] = (*this)(rows+i*stride);
+}
+
+void TreeProfile::merge()const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_visits.assign(m_model.size()+1, 0);
+    m_events = 0;
+    for( std::vector<Counters*>::const_iterator it=m_threads.begin(); it!=m_threads.end(); ++it){
+        for( size_t k=0; k<m_visits.size(); ++k) m_visits[k] += (*it)->visits[k];
+        m_events += (*it)->events;
+    }
+}
+
+void TreeProfile::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for( std::vector<Counters*>::const_iterator it=m_threads.begin(); it!=m_threads.end(); ++it){
+        (*it)->visits.assign(m_model.size()+1, 0);
+        (*it)->events = 0;
+    }
+    m_visits.assign(m_model.size()+1, 0);
+    m_events = 0;
+}
+
+double TreeProfile::depth(unsigned int tree)const
+{
+    // every event reaching the tree visits one leaf: the rest are branch nodes
+    unsigned long long total=0, leaves=0;
+    const CompiledTree::Node* root = m_model.root(tree);
+    for( unsigned int node=0; node<m_model.treeSize(tree); ++node){
+        total += visits(tree, node);
+        if( root[node].isLeaf() ) leaves += visits(tree, node);
+    }
+    return leaves>0? double(total-leaves)/leaves : 0;
+}
+
+double TreeProfile::rejection(unsigned int tree)const
+{
+    unsigned long long rejected=0;
+    const CompiledTree::Node* root = m_model.root(tree);
+    for( unsigned int node=0; node<m_model.treeSize(tree); ++node){
+        if( root[node].isLeaf() && root[node].value==0 ) rejected += visits(tree, node);
+    }
+    return treeVisits(tree)>0? double(rejected)/treeVisits(tree) : 0;
+}
+
+void TreeProfile::printNode(std::ostream& out, unsigned int tree, unsigned int node, long long id)const
+{
+    const CompiledTree::Node& n = m_model.root(tree)[node];
+    out << "\t" << id << "\t" << n.index << "\t" << n.value << "\t" << visits(tree, node) << std::endl;
+    if( n.isLeaf() ) return;
+    printNode(out, tree, n.child, 2*id);
+    printNode(out, tree, n.child+1, 2*id+1);
+}
+
+void TreeProfile::print(std::ostream& out)const
+{
+    merge();
+    out << m_title << "\t(" << m_events << " events)" << std::endl;
+    for( unsigned int tree=0; tree<m_model.treeCount(); ++tree){
+        double weight = m_model.tree(tree).weight;
+        out << "\t0\t-10\t" << weight << "\t" << treeVisits(tree)
+            << "\tdepth " << depth(tree);
+        if( weight<=0 ) out << "\trejected " << rejection(tree);
+        out << std::endl;
+        printNode(out, tree, 0, 1);
+    }
+}
@@ -0,0 +1,358 @@
+/** @file  TreeReader.cpp
+    @brief implementation of class TreeReader
+
+    $Header$
+*/
+#include "classifier/TreeReader.h"
+#include "classifier/ThreadPool.h"
+
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+    bool space(char c){ return c==' ' || c=='\t' || c=='\r'; }
+
+    void error(size_t line, const std::string& why)
+    {
+        std::stringstream msg;
+        msg << "TreeReader: line " << line << ": " << why;
+        throw std::runtime_error(msg.str());
+    }
+
+    /// scan an integer, return false if there is none
+    bool scanInt(const char*& p, long long& value)
+    {
+        while( space(*p) ) ++p;
+        bool negative = *p=='-';
+        if( *p=='-' || *p=='+' ) ++p;
+        if( *p<'0' || *p>'9' ) return false;
+        long long v=0;
+        for( ; *p>='0' && *p<='9'; ++p) v = 10*v + (*p-'0');
+        value = negative? -v : v;
+        return true;
+    }
+
+    /** @brief scan a floating point value, return false if there is none.
+        If the decimal mantissa and the power of ten are both exact doubles, one operation
+        gives the correctly rounded value. Otherwise use strtod.
+    */
+    bool scanDouble(const char*& p, double& value)
+    {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        while( space(*p) ) ++p;
+        const char* start = p;
+        bool negative = *p=='-';
+        if( *p=='-' || *p=='+' ) ++p;
+        unsigned long long mantissa=0;
+        int digits=0, exponent=0;
+        bool any=false;
+        for( ; *p>='0' && *p<='9'; ++p, any=true){
+            if( mantissa==0 && *p=='0' ) continue; // leading zeros do not count
+            if( digits<19 ) { mantissa = 10*mantissa + (*p-'0'); ++digits; }
+            else { ++exponent; digits=99; }
+        }
+        if( *p=='.' ){
+            for( ++p; *p>='0' && *p<='9'; ++p, any=true){
+                if( mantissa==0 && *p=='0' ) { --exponent; continue; }
+                if( digits<19 ) { mantissa = 10*mantissa + (*p-'0'); ++digits; --exponent; }
+                else digits=99;
+            }
+        }
+        if( any && (*p=='e' || *p=='E') ){
+            const char* q = p+1;
+            long long e;
+            if( scanInt(q, e) && q[-1]>='0' && q[-1]<='9' && e>-10000 && e<10000 ) {
+                exponent += static_cast<int>(e);
+                p = q;
+            }
+        }
+        if( any && digits<=19 && mantissa <= (1ULL<<53) && exponent>=-22 && exponent<=22 ) {
+            double m = static_cast<double>(mantissa);
+            value = exponent<0? m/powers[-exponent] : m*powers[exponent];
+            if( negative ) value = -value;
+            return true;
+        }
+        // anything else, including nan and inf. Out of range is the largest, as operator>>
+        char* end;
+        errno = 0;
+        value = std::strtod(start, &end);
+        if( end==start ) return false;
+        if( errno==ERANGE && (value==HUGE_VAL || value==-HUGE_VAL) ) {
+            value = value>0? DBL_MAX : -DBL_MAX;
+        }
+        p = end;
+        return true;
+    }
+
+    bool blank(const char* p)
+    {
+        while( space(*p) ) ++p;
+        return *p=='\n' || *p==0;
+    }
+
+    /// one node line
+    struct Line {
+        long long id;
+        int index;
+        double value;
+        const char* outputs; ///< the outputs of a leaf of a tree with several, after the value
+        bool statistics;     ///< the cover and gain follow
+        double cover, gain;
+        size_t number; ///< line number in the file
+    };
+
+    /// parse a node line: for a leaf of a tree with several outputs, they follow the value
+    bool parse(const char* p, Line& line, unsigned int outputs=1)
+    {
+        long long index;
+        if( !scanInt(p, line.id) || !scanInt(p, index) || !scanDouble(p, line.value) ) return false;
+        line.index = static_cast<int>(index);
+        line.outputs = 0;
+        if( line.index==-1 && outputs>1 ){
+            line.outputs = p;
+            double skip;
+            for( unsigned int k=0; k<outputs; ++k) if( !scanDouble(p, skip) ) return false;
+        }
+        line.cover = line.gain = 0;
+        line.statistics = !blank(p);
+        if( line.statistics && (!scanDouble(p, line.cover) || !scanDouble(p, line.gain)) ) return false;
+        return blank(p);
+    }
+
+    /// parse the id 0 line of a tree: the weight, and the number of outputs if more than one
+    bool parseStart(const char* p, double& weight, unsigned int& outputs)
+    {
+        long long id, index, count=1;
+        if( !scanInt(p, id) || !scanInt(p, index) || !scanDouble(p, weight) ) return false;
+        const char* q = p;
+        double cover, gain;
+        if( scanDouble(q, cover) && scanDouble(q, gain) && blank(q) ) return true; // statistics, ignored
+        if( !blank(p) && (!scanInt(p, count) || count<1) ) return false;
+        outputs = static_cast<unsigned int>(count);
+        return blank(p);
+    }
+
+    typedef std::unordered_map<long long, size_t> IdTable;
+
+    /// place the node with this id, and its subtree, as DecisionTree::compileNode does
+    void place(const std::vector<Line>& lines, const IdTable& ids, size_t k,
+        std::vector<CompiledTree::Node>& nodes, std::vector<CompiledTree::Statistics>* statistics,
+        unsigned int outputs, std::vector<double>& values, unsigned int position)
+    {
+        const Line& line = lines[k];
+        CompiledTree::Node& flat = nodes[position];
+        flat.value = line.value;
+        flat.index = line.index;
+        flat.child = 0;
+        if( statistics!=0 ){
+            statistics->resize(nodes.size());
+            (*statistics)[position].cover = line.cover;
+            (*statistics)[position].gain = line.gain;
+        }
+        if( line.index==-1 ){
+            if( line.outputs==0 ) return;
+            // the outputs go to values, and the leaf points to them
+            flat.child = values.size();
+            const char* p = line.outputs;
+            values.resize(values.size()+outputs);
+            for( unsigned int j=0; j<outputs; ++j) scanDouble(p, values[flat.child+j]);
+            return;
+        }
+
+        IdTable::const_iterator left = ids.find(2*line.id), right = ids.find(2*line.id+1);
+        if( left==ids.end() || right==ids.end() ) error(line.number, "branch node without two children");
+        unsigned int pair = nodes.size();
+        nodes[position].child = pair;
+        nodes.resize(pair+2);
+        // a right child before its sibling in the file is the hot one
+        if( right->second < left->second ){
+            place(lines, ids, right->second, nodes, statistics, outputs, values, pair+1);
+            place(lines, ids, left->second, nodes, statistics, outputs, values, pair);
+        }else{
+            place(lines, ids, left->second, nodes, statistics, outputs, values, pair);
+            place(lines, ids, right->second, nodes, statistics, outputs, values, pair+1);
+        }
+    }
+
+    class TreeTask : public ThreadPool::Task {
+    public:
+        TreeTask(const TreeReader& reader, std::vector<double>& weights,
+            std::vector<std::vector<CompiledTree::Node> >& trees,
+            std::vector<std::vector<CompiledTree::Statistics> >& statistics,
+            std::vector<std::vector<double> >& values)
+            : m_reader(reader), m_weights(weights), m_trees(trees), m_statistics(statistics), m_values(values){}
+        void operator()(unsigned int tree)const
+        {
+            m_reader.readTree(tree, m_weights[tree], m_trees[tree], m_statistics[tree], m_values[tree]);
+        }
+    private:
+        const TreeReader& m_reader;
+        std::vector<double>& m_weights;
+        std::vector<std::vector<CompiledTree::Node> >& m_trees;
+        std::vector<std::vector<CompiledTree::Statistics> >& m_statistics;
+        std::vector<std::vector<double> >& m_values;
+    };
+}
+
+TreeReader::TreeReader(std::istream& in)
+{
+    std::getline(in, m_title);
+    if( !m_title.empty() && m_title[m_title.size()-1]=='\r' ) m_title.erase(m_title.size()-1);
+    m_text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    split(0, 2); // the title is line 1
+}
+
+TreeReader::TreeReader(const std::string& title)
+: m_title(title)
+{}
+
+unsigned int TreeReader::append(const std::string& text, size_t line)
+{
+    size_t pos = m_text.size(), before = m_trees.size();
+    m_text += text;
+    if( !m_text.empty() && m_text[m_text.size()-1]!='\n' ) m_text += '\n';
+    split(pos, line);
+    return m_trees.size()-before;
+}
+
+void TreeReader::split(size_t pos, size_t number)
+{
+    // find the lines, and the trees
+    const char* text = m_text.c_str();
+    bool started = false;          // a tree has started in this part
+    for( ; pos<m_text.size(); ++number){
+        size_t end = m_text.find('\n', pos);
+        if( end==std::string::npos ) end = m_text.size();
+        const char* p = text+pos;
+        m_lines.push_back(pos);
+        pos = end+1;
+        if( blank(p) ) continue;
+        long long id;
+        if( !scanInt(p, id) ) error(number, "expected an id");
+        if( id==0 || (id==1 && m_trees.empty()) ){
+            Tree t;
+            t.weight = 1.0;
+            t.outputs = 1;
+            t.start = t.first = m_lines.size()-1;
+            t.line = number;
+            if( id==0 ){
+                if( !parseStart(text+m_lines.back(), t.weight, t.outputs) ) {
+                    error(number, "expected id, index and weight, and optionally the number of outputs");
+                }
+                if( t.weight <= 0 && t.outputs>1 ) error(number, "a filter has only one output");
+                ++t.first;
+            }
+            if( started ) m_trees.back().end = t.start;
+            m_trees.push_back(t);
+            started = true;
+        }else if( id>0 && !started ){
+            error(number, m_trees.empty()? "node before the first tree" : "expected the start of a tree");
+        }
+    }
+    if( started ) m_trees.back().end = m_lines.size();
+}
+
+size_t TreeReader::offset(unsigned int tree)const
+{
+    return m_lines[m_trees[tree].start];
+}
+
+void TreeReader::readTree(unsigned int tree, double& weight, std::vector<CompiledTree::Node>& nodes,
+                          std::vector<CompiledTree::Statistics>& statistics, std::vector<double>& values)const
+{
+    const Tree& t = m_trees[tree];
+    weight = t.weight;
+    std::vector<Line> lines;
+    IdTable ids;
+    bool any = false; // a line with statistics
+    for( size_t k=t.first; k<t.end; ++k){
+        const char* p = m_text.c_str()+m_lines[k];
+        if( blank(p) ) continue;
+        Line line;
+        line.number = t.line + (k-t.start);
+        if( !parse(p, line, t.outputs) ) {
+            error(line.number, t.outputs>1? "expected id, index and value, the outputs of a leaf, and optionally cover and gain"
+                : "expected id, index and value, or those and cover and gain");
+        }
+        if( line.id<0 ) continue; // ignored, as by DecisionTree
+        any = any || line.statistics;
+        if( line.index<-1 ) error(line.number, "bad index");
+        if( !ids.insert(std::make_pair(line.id, lines.size())).second ) error(line.number, "repeated id");
+        lines.push_back(line);
+    }
+    // every node but the root needs a branch parent
+    for( std::vector<Line>::const_iterator it=lines.begin(); it!=lines.end(); ++it){
+        if( it->id==1 ) continue;
+        IdTable::const_iterator parent = ids.find(it->id/2);
+        if( parent==ids.end() || lines[parent->second].index==-1 ) error(it->number, "node without a parent branch");
+    }
+    IdTable::const_iterator root = ids.find(1);
+    if( root==ids.end() ){
+        std::stringstream msg; msg << "tree " << tree << " has no root node";
+        error(t.line, msg.str());
+    }
+    nodes.assign(1, CompiledTree::Node());
+    nodes.reserve(lines.size());
+    statistics.clear();
+    values.clear();
+    place(lines, ids, root->second, nodes, any? &statistics : 0, t.outputs, values, 0);
+}
+
+void TreeReader::read(CompiledTree& model, unsigned int nthreads)const
+{
+    std::vector<double> weights(m_trees.size());
+    std::vector<std::vector<CompiledTree::Node> > trees(m_trees.size());
+    std::vector<std::vector<CompiledTree::Statistics> > statistics(m_trees.size());
+    std::vector<std::vector<double> > values(m_trees.size());
+    if( nthreads!=1 && m_trees.size()>1 ){
+        ThreadPool pool(nthreads);
+        pool.run(m_trees.size(), TreeTask(*this, weights, trees, statistics, values));
+    }else{
+        for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+            readTree(tree, weights[tree], trees[tree], statistics[tree], values[tree]);
+        }
+    }
+
+    // the number of outputs, which must be the same for all the trees that are not filters
+    unsigned int outputs = 0;
+    for( unsigned int tree=0; tree<m_trees.size(); ++tree){
+        if( weights[tree] <= 0 ) continue;
+        if( outputs==0 ) outputs = m_trees[tree].outputs;
+        else if( m_trees[tree].outputs!=outputs ) error(m_trees[tree].line, "number of outputs differs from the other trees");
+    }
+    if( outputs==0 ) outputs = 1;
+
+    // join them: the statistics, if any tree has them, with zero for the others
+    bool any = false;
+    for( unsigned int tree=0; tree<trees.size(); ++tree) any = any || !statistics[tree].empty();
+    std::vector<CompiledTree::Node> nodes;
+    std::vector<CompiledTree::Statistics> all;
+    std::vector<double> all_values;
+    std::vector<CompiledTree::Tree> positions(m_trees.size());
+    CompiledTree::Statistics none = {0, 0};
+    for( unsigned int tree=0; tree<trees.size(); ++tree){
+        positions[tree].weight = weights[tree];
+        positions[tree].offset = nodes.size();
+        if( !values[tree].empty() ){
+            // the leaf outputs move by those of the trees before
+            unsigned int moved = all_values.size();
+            for( std::vector<CompiledTree::Node>::iterator it=trees[tree].begin(); it!=trees[tree].end(); ++it){
+                if( it->isLeaf() ) it->child += moved;
+            }
+            all_values.insert(all_values.end(), values[tree].begin(), values[tree].end());
+        }
+        nodes.insert(nodes.end(), trees[tree].begin(), trees[tree].end());
+        if( !any ) continue;
+        if( statistics[tree].empty() ) all.resize(nodes.size(), none);
+        else all.insert(all.end(), statistics[tree].begin(), statistics[tree].end());
+    }
+    model.adopt(nodes, positions, all, outputs, all_values);
+}
@@ -0,0 +1,293 @@
+/** @file  TreeSimplifier.cpp
+    @brief implementation of class TreeSimplifier
+
+    $Header$
+*/
+#include "classifier/TreeSimplifier.h"
+
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace {
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    /// append the bytes of a value to a key
+    template<class T>
+    void append(std::string& out, const T& value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+
+TreeSimplifier::TreeSimplifier(const CompiledTree& model, bool merge)
+: m_before(model.size())
+, m_trees_before(model.treeCount())
+, m_decided(0)
+, m_collapsed(0)
+, m_merged(0)
+{
+    if( model.outputs()>1 ) throw std::invalid_argument("TreeSimplifier: trees with several outputs are not supported");
+    size_t width = model.width();
+    Box all;
+    all.low.assign(width, -infinity);
+    all.high.assign(width, infinity);
+    all.nan.assign(width, true);
+
+    // the box around the events that pass every filter
+    Box filters(all);
+    bool reject_all = false;
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        if( model.tree(tree).weight > 0 ) continue;
+        Box box(all), hull;
+        hull.low.assign(width, infinity);
+        hull.high.assign(width, -infinity);
+        hull.nan.assign(width, false);
+        bool any = false;
+        passing(model.root(tree), 0, box, hull, any);
+        if( !any ) { reject_all = true; break; }
+        for( size_t j=0; j<width; ++j){
+            if( hull.low[j] > filters.low[j] ) filters.low[j] = hull.low[j];
+            if( hull.high[j] < filters.high[j] ) filters.high[j] = hull.high[j];
+            filters.nan[j] = filters.nan[j] && hull.nan[j];
+        }
+    }
+    if( reject_all ) filters = all; // nothing passes: the other trees do not matter, leave them
+
+    // simplify each tree, filters only from their own cuts
+    std::vector<Tree> trees(model.treeCount());
+    std::vector<int> roots(model.treeCount());
+    std::vector<double> weights(model.treeCount());
+    for( unsigned int tree=0; tree<model.treeCount(); ++tree){
+        weights[tree] = model.tree(tree).weight;
+        Box box( weights[tree] > 0 ? filters : all );
+        roots[tree] = simplify(model.root(tree), model.statistics(tree), 0, box, trees[tree]);
+    }
+
+    // repeated filters, and optionally trees with the same tests: find the first of each
+    std::vector<int> first(trees.size(), -1);
+    std::map<std::string, unsigned int> seen;
+    for( unsigned int tree=0; tree<trees.size(); ++tree){
+        bool filter = weights[tree] <= 0;
+        if( !filter && !merge ) continue;
+        std::string k(1, filter? 'f' : 't');
+        key(trees[tree], roots[tree], filter, k);
+        std::map<std::string, unsigned int>::const_iterator it = seen.find(k);
+        if( it==seen.end() ) { seen[k] = tree; continue; }
+        first[tree] = it->second;
+        ++m_merged;
+    }
+    // merged trees: at each leaf, the sum of weight times value, divided by the sum of weights
+    std::vector<double> sum_of_weights(weights);
+    std::vector<bool> scaled(trees.size(), false); // leaves multiplied by the weight: a tree merged into
+    for( unsigned int tree=0; tree<trees.size(); ++tree){
+        if( first[tree]<0 || weights[tree] <= 0 ) continue;
+        unsigned int into = first[tree];
+        if( !scaled[into] ) {
+            multiplyLeaves(trees[into], roots[into], weights[into]);
+            scaled[into] = true;
+        }
+        addLeaves(trees[into], roots[into], trees[tree], roots[tree], weights[tree]);
+        sum_of_weights[into] += weights[tree];
+    }
+    for( unsigned int tree=0; tree<trees.size(); ++tree){
+        if( !scaled[tree] ) continue;
+        divideLeaves(trees[tree], roots[tree], sum_of_weights[tree]);
+        weights[tree] = sum_of_weights[tree];
+    }
+
+    std::vector<CompiledTree::Node> nodes;
+    std::vector<CompiledTree::Statistics> statistics;
+    std::vector<CompiledTree::Tree> positions;
+    for( unsigned int tree=0; tree<trees.size(); ++tree){
+        if( first[tree]>=0 ) continue;
+        CompiledTree::Tree t;
+        t.weight = weights[tree];
+        t.offset = nodes.size();
+        positions.push_back(t);
+        std::vector<CompiledTree::Node> flat(1);
+        std::vector<CompiledTree::Statistics> stats;
+        place(trees[tree], roots[tree], flat, model.hasStatistics()? &stats : 0, 0);
+        nodes.insert(nodes.end(), flat.begin(), flat.end());
+        statistics.insert(statistics.end(), stats.begin(), stats.end());
+    }
+    m_model.adopt(nodes, positions, statistics);
+}
+
+namespace {
+    /// the test is passed by every value in the range: x < high <= cut, and not NaN
+    bool alwaysLeft(double high, bool nan, double cut)
+    {
+        return !nan && high < infinity && high <= cut;
+    }
+    /// the test fails for every value: cut <= low <= x, or NaN, which also goes right
+    bool alwaysRight(double low, double cut)
+    {
+        return low >= cut;
+    }
+}
+
+int TreeSimplifier::simplify(const CompiledTree::Node* root, const CompiledTree::Statistics* statistics,
+                             unsigned int position, Box& box, Tree& out)
+{
+    const CompiledTree::Node& node = root[position];
+    CompiledTree::Statistics stats = {0, 0};
+    if( statistics!=0 ) stats = statistics[position];
+    if( node.isLeaf() ){
+        Node leaf;
+        leaf.value = node.value;
+        leaf.index = -1;
+        leaf.left = leaf.right = -1;
+        leaf.right_first = false;
+        leaf.statistics = stats;
+        out.push_back(leaf);
+        return out.size()-1;
+    }
+    // a node replaced by a child: the child takes its cover, and the gain is lost
+    int j = node.index, taken = -1;
+    double low = box.low[j], high = box.high[j], cut = node.value;
+    bool nan = box.nan[j];
+    if( alwaysLeft(high, nan, cut) ) {
+        ++m_decided;
+        taken = simplify(root, statistics, node.child, box, out);
+    }else if( alwaysRight(low, cut) ) {
+        ++m_decided;
+        taken = simplify(root, statistics, node.child+1, box, out);
+    }
+    if( taken>=0 ){
+        out[taken].statistics.cover = stats.cover;
+        return taken;
+    }
+
+    // left: x < cut, so not NaN
+    if( cut < high ) box.high[j] = cut;
+    box.nan[j] = false;
+    int left = simplify(root, statistics, node.child, box, out);
+    box.high[j] = high;
+    box.nan[j] = nan;
+    // right: x >= cut, or NaN
+    if( cut > low ) box.low[j] = cut;
+    int right = simplify(root, statistics, node.child+1, box, out);
+    box.low[j] = low;
+
+    if( same(out, left, out, right) ) {
+        ++m_collapsed;
+        out[left].statistics.cover = stats.cover;
+        return left;
+    }
+    Node branch;
+    branch.value = cut;
+    branch.index = j;
+    branch.left = left;
+    branch.right = right;
+    branch.statistics = stats;
+    // keep the hot child first: see DecisionTree::optimizeLayout
+    const CompiledTree::Node &l = root[node.child], &r = root[node.child+1];
+    branch.right_first = !l.isLeaf() && !r.isLeaf() && r.child < l.child;
+    out.push_back(branch);
+    return out.size()-1;
+}
+
+void TreeSimplifier::passing(const CompiledTree::Node* root, unsigned int position, Box& box, Box& hull, bool& any)const
+{
+    const CompiledTree::Node& node = root[position];
+    if( node.isLeaf() ){
+        if( node.value != 1.0 ) return;
+        any = true;
+        for( size_t j=0; j<box.low.size(); ++j){
+            if( box.low[j] < hull.low[j] ) hull.low[j] = box.low[j];
+            if( box.high[j] > hull.high[j] ) hull.high[j] = box.high[j];
+            if( box.nan[j] ) hull.nan[j] = true;
+        }
+        return;
+    }
+    int j = node.index;
+    double low = box.low[j], high = box.high[j], cut = node.value;
+    bool nan = box.nan[j];
+    if( alwaysLeft(high, nan, cut) ) { passing(root, node.child, box, hull, any); return; }
+    if( alwaysRight(low, cut) ) { passing(root, node.child+1, box, hull, any); return; }
+    if( cut < high ) box.high[j] = cut;
+    box.nan[j] = false;
+    passing(root, node.child, box, hull, any);
+    box.high[j] = high;
+    box.nan[j] = nan;
+    if( cut > low ) box.low[j] = cut;
+    passing(root, node.child+1, box, hull, any);
+    box.low[j] = low;
+}
+
+bool TreeSimplifier::same(const Tree& a, int i, const Tree& b, int j)
+{
+    const Node &x = a[i], &y = b[j];
+    if( x.index!=y.index || !(x.value==y.value) ) return false;
+    if( x.index<0 ) return true;
+    return same(a, x.left, b, y.left) && same(a, x.right, b, y.right);
+}
+
+void TreeSimplifier::key(const Tree& tree, int i, bool values, std::string& out)
+{
+    const Node& node = tree[i];
+    if( node.index<0 ){
+        out += 'L';
+        if( values ) append(out, node.value);
+        return;
+    }
+    out += 'B';
+    append(out, node.index);
+    append(out, node.value);
+    key(tree, node.left, values, out);
+    key(tree, node.right, values, out);
+}
+
+void TreeSimplifier::addLeaves(Tree& a, int i, const Tree& b, int j, double weight)
+{
+    if( a[i].index<0 ) { a[i].value += weight*b[j].value; return; }
+    addLeaves(a, a[i].left, b, b[j].left, weight);
+    addLeaves(a, a[i].right, b, b[j].right, weight);
+}
+
+void TreeSimplifier::multiplyLeaves(Tree& a, int i, double factor)
+{
+    if( a[i].index<0 ) { a[i].value *= factor; return; }
+    multiplyLeaves(a, a[i].left, factor);
+    multiplyLeaves(a, a[i].right, factor);
+}
+
+void TreeSimplifier::divideLeaves(Tree& a, int i, double divisor)
+{
+    if( a[i].index<0 ) { a[i].value /= divisor; return; }
+    divideLeaves(a, a[i].left, divisor);
+    divideLeaves(a, a[i].right, divisor);
+}
+
+void TreeSimplifier::place(const Tree& tree, int i, std::vector<CompiledTree::Node>& nodes,
+                           std::vector<CompiledTree::Statistics>* statistics, unsigned int position)
+{
+    const Node& node = tree[i];
+    nodes[position].value = node.value;
+    nodes[position].index = node.index;
+    nodes[position].child = 0;
+    if( statistics!=0 ){
+        statistics->resize(nodes.size());
+        (*statistics)[position] = node.statistics;
+    }
+    if( node.index<0 ) return;
+    unsigned int pair = nodes.size();
+    nodes[position].child = pair;
+    nodes.resize(pair+2);
+    if( node.right_first ){
+        place(tree, node.right, nodes, statistics, pair+1);
+        place(tree, node.left, nodes, statistics, pair);
+    }else{
+        place(tree, node.left, nodes, statistics, pair);
+        place(tree, node.right, nodes, statistics, pair+1);
+    }
+}
+
+void TreeSimplifier::print(std::ostream& out)const
+{
+    out << "TreeSimplifier: " << m_trees_before << " trees, " << m_before << " nodes, now "
+        << m_model.treeCount() << " trees, " << m_model.size() << " nodes\n"
+        << "\t" << m_decided << " tests decided, " << m_collapsed << " branches with equal children, "
+        << m_merged << " trees merged or dropped" << std::endl;
+}
@@ -0,0 +1,213 @@
+/** @file VariableScreen.cpp
+@brief implementation of the class VariableScreen
+
+$Header$
+*/
+#include "classifier/VariableScreen.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+#include <thread>
+
+unsigned int VariableScreen::s_correlation_sample = 10000;
+
+namespace {
+
+    /// same criterion as the Gini class used by Classifier::Node
+    double gini(double signal, double background)
+    {
+        double total=signal+background;
+        return total>0? 2*signal*background/total : 0;
+    }
+
+    /// value and weights of one record, for a single column
+    struct Entry {
+        float value;
+        float signal, background;
+        bool operator<(const Entry& other)const{return value < other.value;}
+    };
+
+    /** @brief find the best single cut on column n.
+    The cut is placed at a record value, the left side is less than it, as in Classifier::Node::split
+    */
+    void rate(const Classifier::Table& data, int n, double& improvement, double& cut)
+    {
+        std::vector<Entry> entries; entries.reserve(data.size());
+        double totsig=0, totbkg=0;
+        for( Classifier::Table::const_iterator it=data.begin(); it!=data.end(); ++it){
+            Entry e;
+            e.value = (*it)[n];
+            e.signal = it->weight(true);
+            e.background = it->weight(false);
+            totsig += e.signal; totbkg += e.background;
+            entries.push_back(e);
+        }
+        std::sort(entries.begin(), entries.end());
+        double gtot = gini(totsig, totbkg), best = gtot, sig=0, bkg=0;
+        cut = entries.empty()? 0 : entries.front().value;
+        for( size_t i=0; i+1<entries.size(); ++i){
+            sig += entries[i].signal;
+            bkg += entries[i].background;
+            if( entries[i].value == entries[i+1].value) continue; // can only cut between values
+            double g = gini(sig, bkg) + gini(totsig-sig, totbkg-bkg);
+            if( g < best) { best = g; cut = entries[i+1].value; }
+        }
+        improvement = gtot-best;
+    }
+
+    /// standardize a column of the sample, so that the correlation is a weighted mean of products
+    void standardize(const Classifier::Table& data, int n, size_t stride,
+        const std::vector<double>& weights, std::vector<float>& column)
+    {
+        double sumw=0, sumx=0, sumxx=0;
+        size_t k=0;
+        for( size_t i=0; i<data.size(); i+=stride, ++k){
+            double x = data[i][n], w = weights[k];
+            sumw += w; sumx += w*x; sumxx+= w*x*x;
+        }
+        double mean = sumw>0? sumx/sumw : 0,
+            var = sumw>0? sumxx/sumw - mean*mean : 0,
+            scale = var>0? 1/sqrt(var) : 0; // constant column: all zero, uncorrelated
+        column.resize(k);
+        k=0;
+        for( size_t i=0; i<data.size(); i+=stride, ++k){
+            column[k] = static_cast<float>((data[i][n]-mean)*scale);
+        }
+    }
+
+    /// order columns by decreasing rating
+    class ByRating {
+    public:
+        ByRating(const std::vector<double>& ratings): m_ratings(ratings){}
+        bool operator()(int a, int b)const{return m_ratings[a] > m_ratings[b];}
+    private:
+        const std::vector<double>& m_ratings;
+    };
+
+} // anon namespace
+
+VariableScreen::VariableScreen(const Classifier::Table& data, int nthreads)
+: m_nvar(Classifier::Record::size())
+, m_ratings(m_nvar)
+, m_cuts(m_nvar)
+, m_sample(m_nvar)
+, m_status(m_nvar)
+{
+    if( data.empty()) throw std::invalid_argument("VariableScreen: table is empty");
+    if( nthreads<=0 ) nthreads = std::thread::hardware_concurrency();
+    if( nthreads>m_nvar) nthreads = m_nvar;
+    if( nthreads<=0 ) nthreads = 1;
+
+    size_t stride = std::max<size_t>(1, data.size()/s_correlation_sample);
+    for( size_t i=0; i<data.size(); i+=stride) m_sample_weights.push_back(data[i].weight());
+
+    // each thread does every nthreads'th column: they write to separate elements only
+    class Worker {
+    public:
+        Worker(VariableScreen& screen, const Classifier::Table& data, size_t stride, int first, int step)
+            : m_screen(screen), m_data(data), m_stride(stride), m_first(first), m_step(step){}
+        void operator()()const
+        {
+            for( int n=m_first; n<m_screen.m_nvar; n+=m_step){
+                rate(m_data, n, m_screen.m_ratings[n], m_screen.m_cuts[n]);
+                standardize(m_data, n, m_stride, m_screen.m_sample_weights, m_screen.m_sample[n]);
+            }
+        }
+    private:
+        VariableScreen& m_screen;
+        const Classifier::Table& m_data;
+        size_t m_stride;
+        int m_first, m_step;
+    };
+    std::vector<std::thread> threads;
+    for( int t=1; t<nthreads; ++t){
+        threads.push_back(std::thread(Worker(*this, data, stride, t, nthreads)));
+    }
+    Worker(*this, data, stride, 0, nthreads)(); // this thread does its share
+    for( size_t t=0; t<threads.size(); ++t) threads[t].join();
+
+    // until select is called, all are selected
+    for( int n=0; n<m_nvar; ++n) m_selected.push_back(n);
+}
+
+double VariableScreen::correlation(int i, int j)const
+{
+    const std::vector<float>& a = m_sample[i], &b= m_sample[j];
+    double sumw=0, sum=0;
+    for( size_t k=0; k<a.size(); ++k){
+        sumw += m_sample_weights[k];
+        sum  += m_sample_weights[k]*a[k]*b[k];
+    }
+    return sumw>0? sum/sumw : 0;
+}
+
+const std::vector<int>& VariableScreen::select(unsigned int keep,
+    const std::vector<std::string>& forced, double max_correlation)
+{
+    std::vector<bool> kept(m_nvar, false);
+    m_status.assign(m_nvar, std::string());
+
+    for( std::vector<std::string>::const_iterator it=forced.begin(); it!=forced.end(); ++it){
+        int n=0;
+        while( n<m_nvar && Classifier::Record::columnName(n)!= *it) ++n;
+        if( n==m_nvar) throw std::invalid_argument("VariableScreen::select: forced variable "+*it+" not found");
+        kept[n]=true;
+        m_status[n] = "forced";
+    }
+
+    std::vector<int> order;
+    for( int n=0; n<m_nvar; ++n) order.push_back(n);
+    std::stable_sort(order.begin(), order.end(), ByRating(m_ratings));
+
+    unsigned int count=0;
+    for( std::vector<int>::const_iterator it=order.begin(); it!=order.end(); ++it){
+        int n = *it;
+        if( kept[n] ) continue;
+        if( m_ratings[n]<=0) { m_status[n] = "dropped: no improvement"; continue; }
+        if( count>=keep ) { m_status[n] = "dropped: rank"; continue; }
+
+        // check against those already kept, which all have a better rating or are forced
+        int twin=-1; double rmax=0;
+        for( int j=0; j<m_nvar; ++j){
+            if( !kept[j]) continue;
+            double r = fabs(correlation(n,j));
+            if( r>rmax) { rmax = r; twin=j;}
+        }
+        if( twin>=0 && rmax > max_correlation){
+            std::stringstream reason;
+            reason << "dropped: duplicate of " << Classifier::Record::columnName(twin)
+                << " (r=" << std::setprecision(4) << rmax << ")";
+            m_status[n] = reason.str();
+            continue;
+        }
+        kept[n]=true;
+        m_status[n] = "selected";
+        ++count;
+    }
+
+    m_selected.clear();
+    for( int n=0; n<m_nvar; ++n) if( kept[n]) m_selected.push_back(n);
+    return m_selected;
+}
+
+void VariableScreen::print(std::ostream& log)const
+{
+    std::vector<int> order;
+    for( int n=0; n<m_nvar; ++n) order.push_back(n);
+    std::stable_sort(order.begin(), order.end(), ByRating(m_ratings));
+
+    log << "\n\tVariable screening: " << m_selected.size() << " of " << m_nvar << " selected\n"
+        << std::setw(20) << std::left << "Name"
+        << std::setw(12) << std::left << "improvement"
+        << std::setw(12) << std::left << "best cut" << "status\n";
+    for( std::vector<int>::const_iterator it=order.begin(); it!=order.end(); ++it){
+        int n = *it;
+        log << std::setw(20) << std::left << Classifier::Record::columnName(n)
+            << std::setw(12) << std::left << std::setprecision(5) << m_ratings[n]
+            << std::setw(12) << std::left << m_cuts[n]
+            << (m_status[n].empty()? "selected" : m_status[n]) << std::endl;
+    }
+}
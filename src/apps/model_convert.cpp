@@ -0,0 +1,50 @@
+/** @file model_convert.cpp
+    @brief convert a model between the text and binary formats
+
+    usage:
+    @verbatim
+    model_convert treeInfoFolder model.bin   # dtree.txt and variables.txt to binary
+    model_convert model.bin dtree.txt        # binary to text; the variables are listed on stdout
+    @endverbatim
+
+    $Header$
+*/
+#include "classifier/DecisionTree.h"
+#include "classifier/ModelFile.h"
+#include "classifier/TrainingInfo.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char** argv)
+{
+    if( argc!=3 ) {
+        std::cerr << "usage: model_convert treeInfoFolder model.bin\n"
+                  << "       model_convert model.bin dtree.txt" << std::endl;
+        return 2;
+    }
+    std::string input(argv[1]), output(argv[2]);
+    try {
+        if( ModelFile::isModelFile(input) ){
+            ModelFile model(input);
+            std::ofstream out(output.c_str());
+            if( !out.is_open() ) throw std::invalid_argument("cannot open "+output);
+            model.print(out);
+            for( size_t i=0; i<model.variables().size(); ++i){
+                std::cout << model.variables()[i] << std::endl;
+            }
+        }else{
+            std::string filename(input+"/dtree.txt");
+            std::ifstream in(filename.c_str());
+            if( !in.is_open() ) throw std::invalid_argument("cannot open "+filename);
+            DecisionTree dtree(in);
+            TrainingInfo info(input);
+            ModelFile::write(output, dtree, info.vars());
+        }
+    }catch (const std::exception& error){
+        std::cerr << "Caught exception \"" << error.what() << "\"" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+/** @file latency.cpp
+    @brief benchmark: time to evaluate one event, serially and with LatencyScorer
+
+    usage: latency_benchmark [trees [depth [threads [events [first_cpu]]]]]
+
+    Makes a random ensemble of complete trees, then reports the median and 99th percentile
+    of the time per event for DecisionTree::operator() and for LatencyScorer.
+
+    $Header$
+*/
+#include "classifier/DecisionTree.h"
+#include "classifier/LatencyScorer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    std::mt19937 engine(12345);
+    const int nvar = 20;
+
+    void grow(DecisionTree& dtree, DecisionTree::Identifier_t id, int depth)
+    {
+        if( depth==0 ) {
+            dtree.addNode(id, -1, std::uniform_real_distribution<double>(0,1)(engine));
+            return;
+        }
+        dtree.addNode(id, engine()%nvar, std::normal_distribution<double>(0,1)(engine));
+        grow(dtree, 2*id, depth-1);
+        grow(dtree, 2*id+1, depth-1);
+    }
+
+    /// time each event, return the times in ns, sorted
+    template<class F>
+    std::vector<double> timeEvents(F& f, const std::vector<float>& rows, size_t events, double& check)
+    {
+        typedef std::chrono::steady_clock Clock;
+        std::vector<double> times(events);
+        check=0;
+        for( size_t i=0; i<events; ++i){
+            Clock::time_point start = Clock::now();
+            check += f(&rows[i*nvar]);
+            times[i] = std::chrono::duration<double, std::nano>(Clock::now()-start).count();
+        }
+        std::sort(times.begin(), times.end());
+        return times;
+    }
+
+    void report(const std::string& name, const std::vector<double>& times)
+    {
+        std::cout << std::setw(12) << std::left << name << std::fixed << std::setprecision(0)
+            << "p50 " << std::setw(10) << times[times.size()/2]
+            << "p99 " << std::setw(10) << times[times.size()*99/100] << " ns" << std::endl;
+    }
+
+    class Serial {
+    public:
+        Serial(const DecisionTree& dtree): m_dtree(dtree){}
+        double operator()(const float* row)const{return m_dtree(row, nvar);}
+    private:
+        const DecisionTree& m_dtree;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    int ntrees   = argc>1? atoi(argv[1]) : 500,
+        depth    = argc>2? atoi(argv[2]) : 6,
+        nthreads = argc>3? atoi(argv[3]) : 4,
+        events   = argc>4? atoi(argv[4]) : 100000,
+        first_cpu= argc>5? atoi(argv[5]) : -1;
+    try {
+        DecisionTree dtree("benchmark");
+        for( int t=0; t<ntrees; ++t){
+            dtree.addNode(0, -10, 1.0);
+            grow(dtree, 1, depth);
+        }
+        dtree.compile();
+
+        std::vector<float> rows(events*nvar);
+        std::normal_distribution<float> gauss(0,1);
+        for( size_t i=0; i<rows.size(); ++i) rows[i] = gauss(engine);
+
+        std::cout << ntrees << " trees of depth " << depth << ", " << events << " events\n";
+        double serial_check, latency_check;
+        Serial serial(dtree);
+        report("serial", timeEvents(serial, rows, events, serial_check));
+        LatencyScorer scorer(dtree.compiled(), nthreads, first_cpu);
+        std::stringstream name; name << scorer.threads() << " threads";
+        report(name.str(), timeEvents(scorer, rows, events, latency_check));
+        if( serial_check != latency_check ) throw std::runtime_error("results differ");
+    }catch (const std::exception& error){
+        std::cerr << "Caught exception \"" << error.what() << "\"" << std::endl;
+        return 1;
+    }
+    return 0;
+}
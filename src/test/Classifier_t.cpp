@@ -10,11 +10,46 @@
 #include "classifier/AdaBoost.h"
 #include "classifier/DecisionTree.h"
 #include "classifier/Filter.h"
+#include "classifier/VariableScreen.h"
+#include "classifier/QuickScorer.h"
+#include "classifier/BinnedTree.h"
+#include "classifier/ParallelScorer.h"
+#include "classifier/LatencyScorer.h"
+#include "classifier/TreeProfile.h"
+#include "classifier/CutChain.h"
+#include "classifier/ModelSet.h"
+#include "classifier/ModelFile.h"
+#include "classifier/TreeReader.h"
+#include "classifier/ModelHandle.h"
+#include "classifier/TreeSimplifier.h"
+#include "classifier/TreeExplainer.h"
+#include "classifier/GeneratedTree.h"
 
 #include "CLHEP/Random/RandGauss.h"
 
+#if defined(__has_include)
+# if __has_include("TFile.h")
+#  define CLASSIFIER_TEST_ROOT // ROOT is available: also read trees from a file
+# endif
+#endif
+#ifdef CLASSIFIER_TEST_ROOT
+#include "classifier/RootTuple.h"
+#include "classifier/RootLoader.h"
+#include "classifier/RootPrefetch.h"
+#include "TFile.h"
+#include "TTree.h"
+#endif
+
 #include <stdexcept>
 #include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <sstream>
+#include <algorithm>
 
 //using Classifier::Table;
 //using Classifier::Record;
@@ -87,6 +122,8 @@ public:
        double r1 = dtree(TestValue(event(1.0)));
        if( r1 != q1) throw std::runtime_error("second evalution did not match");
 
+       testExplain(tree, dtree);
+
 
        delete &dtree;
 
@@ -99,6 +136,13 @@ public:
        // test creating and using a filter
 
        testFilter(fromfile);
+
+       testScreen();
+
+       testClasses();
+#ifdef CLASSIFIER_TEST_ROOT
+       testRoot();
+#endif
     }
     void defineEvent()
     {
@@ -179,7 +223,774 @@ public:
 
         std::cout << "Filter OK!" << std::endl;
 
+        testBatch(ftree);
+        testGenerated(ftree);
+        testCascade(ftree);
+        testParallel(ftree);
+        testProfile(ftree);
+        testLayout();
+        testModelSet(ftree);
+        testModelFile(ftree);
+        testReader(ftree);
+        testHandle(ftree);
+        testSimplify(ftree);
+
+    }
+
+    /// compare block evaluation, by rows and by columns, with one at a time
+    void testBatch(const DecisionTree& dtree)
+    {
+        std::vector<float> rows, xcol, ycol;
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            rows.insert(rows.end(), e.begin(), e.end());
+            xcol.push_back(e[0]); ycol.push_back(e[1]);
+        }
+        const float* columns[] = {&xcol[0], &ycol[0]};
+        std::vector<float> colmajor(xcol);
+        colmajor.insert(colmajor.end(), ycol.begin(), ycol.end());
+        std::vector<double> byrow(1000), bycol(1000), quick(1000), binned(1000);
+        dtree.evaluate(&rows[0], 1000, 2, &byrow[0]);
+        dtree.evaluate(columns, 1000, &bycol[0]);
+        QuickScorer scorer(dtree.compiled());
+        scorer.evaluate(&rows[0], 1000, 2, &quick[0]);
+        BinnedTree btree(dtree.compiled());
+        btree.evaluate(&rows[0], 1000, 2, &binned[0]);
+        for( int i=0; i<1000; ++i){
+            double expect = dtree(event(xcol[i], ycol[i]));
+            if( byrow[i]!=expect || bycol[i]!=expect) throw std::runtime_error("batch evaluation did not match");
+            if( quick[i]!=expect || scorer(&rows[2*i])!=expect ) throw std::runtime_error("QuickScorer evaluation did not match");
+            if( binned[i]!=expect || btree(&rows[2*i])!=expect ) throw std::runtime_error("BinnedTree evaluation did not match");
+
+            // in place: row pointer, double values, and a view of the column-major matrix
+            double drow[] = {xcol[i], ycol[i]};
+            if( dtree(&rows[2*i], 2)!=expect || dtree(drow, 2)!=expect
+                || dtree.evaluate(DecisionTree::Strided<float>(&colmajor[i], 1000))!=expect ) {
+                throw std::runtime_error("in place evaluation did not match");
+            }
+        }
+
+        // the filter, as cuts applied to the columns
+        CutChain chain(dtree.compiled(), 0);
+        chain.order(columns, 1000);
+        std::vector<CutChain::Word> mask(16);
+        size_t passed = chain.evaluate(columns, 1000, &mask[0]), expect_passed=0;
+        for( int i=0; i<1000; ++i){
+            double expect = dtree.compiled().evaluate(0, &rows[2*i]);
+            expect_passed += expect==1;
+            if( ((mask[i/64]>>(i%64))&1) != expect || chain(&rows[2*i])!=expect ) {
+                throw std::runtime_error("CutChain did not match the filter");
+            }
+        }
+        if( passed!=expect_passed ) throw std::runtime_error("CutChain count is wrong");
+
+        // rows narrower than the variables used
+        bool thrown = false;
+        try { dtree.evaluate(&rows[0], 1, 0, &byrow[0]); }catch(const std::invalid_argument&){ thrown = true; }
+        dtree.evaluate(&rows[0], 0, 0, &byrow[0]); // nothing to read
+        if( !thrown ) throw std::runtime_error("batch evaluation: short rows not rejected");
+        std::cout << "Batch OK!" << std::endl;
+    }
+
+    /// write code for the tree, build it as a shared library, and compare 
+    void testGenerated(const DecisionTree& dtree)
+    {
+#ifndef WIN32
+        std::cout << "\nTesting generated code...\n";
+        {
+            std::ofstream src("generated_tree.cpp");
+            dtree.printCode(src, "test_tree");
+        }
+        {
+            // values that are not finite must still be valid C++
+            DecisionTree odd("odd");
+            odd.addNode(0, -10, 1.0);
+            odd.addNode(1, 0, std::numeric_limits<double>::infinity());
+            odd.addNode(2, -1, std::numeric_limits<double>::quiet_NaN());
+            odd.addNode(3, -1, -std::numeric_limits<double>::infinity());
+            std::ostringstream code;
+            odd.printCode(code, "odd");
+            if( code.str().find("< std::numeric_limits<double>::infinity()")==std::string::npos
+                || code.str().find("return std::numeric_limits<double>::quiet_NaN()")==std::string::npos
+                || code.str().find("return -std::numeric_limits<double>::infinity()")==std::string::npos ) {
+                throw std::runtime_error("generated code: values not finite are not written as C++");
+            }
+        }
+        const char* cxx = ::getenv("CXX");
+        std::string compiler(cxx!=0? cxx : "c++");
+        if( ::system((compiler+" --version >/dev/null 2>&1").c_str())!=0 ){
+            std::cout << "No compiler " << compiler << " found: generated code not built" << std::endl;
+            return;
+        }
+        std::string command = compiler
+            + " -O2 -shared -fPIC -ffp-contract=off -o generated_tree.so generated_tree.cpp";
+        if( ::system(command.c_str())!=0 ) throw std::runtime_error("could not build generated code: "+command);
+
+        GeneratedTree gtree("./generated_tree.so", "test_tree");
+        std::vector<float> rows;
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            if( gtree(e) != dtree(e) ) throw std::runtime_error("generated code did not match");
+            rows.insert(rows.end(), e.begin(), e.end());
+        }
+        std::vector<double> scores(1000), expect(1000);
+        gtree.evaluate(&rows[0], 1000, 2, &scores[0]);
+        dtree.evaluate(&rows[0], 1000, 2, &expect[0]);
+        if( scores!=expect ) throw std::runtime_error("generated code block did not match");
+        std::cout << "Generated code OK!" << std::endl;
+#endif
+    }
+
+    /// limit on the number of trees, and the early-exit test against a cut
+    void testCascade(const DecisionTree& ftree)
+    {
+        // the filter and tree, followed by a second tree on y
+        DecisionTree ens(ftree.title());
+        ens.addTree(&ftree);
+        ens.addNode(0, -10, 0.5);
+        ens.addNode(1, 1, 0.0);
+        ens.addNode(2, -1, 0.2);
+        ens.addNode(3, -1, 0.9);
+
+        std::vector<float> rows;
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            rows.insert(rows.end(), e.begin(), e.end());
+            // one tree, after the filter, is the old one
+            if( ens(e, 1) != ftree(e) ) throw std::runtime_error("tree_count: did not match");
+            for( double cut=0.1; cut<1; cut+=0.1){
+                if( ens.accept(e, cut) != (ens(e) >= cut) ) throw std::runtime_error("accept did not match");
+            }
+        }
+        std::vector<double> scores(1000), expect(1000);
+        ens.evaluate(&rows[0], 1000, 2, &scores[0], 1);
+        ftree.evaluate(&rows[0], 1000, 2, &expect[0]);
+        if( scores!=expect ) throw std::runtime_error("tree_count: block did not match");
+        std::cout << "Cascade OK!" << std::endl;
+    }
+
+    /// several threads sharing one tree and one scorer, compared with a single thread
+    void testParallel(const DecisionTree& dtree)
+    {
+        const size_t count=100000;
+        std::vector<float> rows;
+        for( size_t i=0; i<count; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            rows.insert(rows.end(), e.begin(), e.end());
+        }
+        std::vector<double> expect(count);
+        dtree.evaluate(&rows[0], count, 2, &expect[0]);
+
+        ParallelScorer scorer(dtree, 4);
+        class Worker {
+        public:
+            Worker(const DecisionTree& dtree, const ParallelScorer& scorer,
+                const std::vector<float>& rows, const std::vector<double>& expect, int& failures)
+                : m_dtree(dtree), m_scorer(scorer), m_rows(rows), m_expect(expect), m_failures(failures){}
+            void operator()()const
+            {
+                size_t count = m_expect.size();
+                std::vector<double> scores(count);
+                for( int pass=0; pass<5; ++pass){
+                    m_scorer.evaluate(&m_rows[0], count, 2, &scores[0]);
+                    if( scores!=m_expect ) ++m_failures;
+                    for( size_t i=0; i<count; i+=97){
+                        if( m_dtree(&m_rows[2*i], 2)!=m_expect[i] ) { ++m_failures; break; }
+                    }
+                }
+            }
+        private:
+            const DecisionTree& m_dtree;
+            const ParallelScorer& m_scorer;
+            const std::vector<float>& m_rows;
+            const std::vector<double>& m_expect;
+            int& m_failures;
+        };
+        std::vector<int> failures(4, 0);
+        std::vector<std::thread> threads;
+        for( int t=0; t<4; ++t){
+            threads.push_back(std::thread(Worker(dtree, scorer, rows, expect, failures[t])));
+        }
+        for( int t=0; t<4; ++t) threads[t].join();
+        for( int t=0; t<4; ++t){
+            if( failures[t]!=0 ) throw std::runtime_error("parallel evaluation did not match");
+        }
+
+        // one event at a time, the trees divided among three threads
+        LatencyScorer latency(dtree.compiled(), 3);
+        for( size_t i=0; i<count; i+=101){
+            if( latency(&rows[2*i])!=expect[i] ) throw std::runtime_error("LatencyScorer did not match");
+        }
+        std::cout << "Parallel OK!" << std::endl;
+    }
+
+    /// count node visits: the filter sees every event, the tree only those that pass
+    void testProfile(const DecisionTree& ftree)
+    {
+        TreeProfile profile(ftree);
+        int passed=0;
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            if( profile(e)!=ftree(e) ) throw std::runtime_error("profile evaluation did not match");
+            if( e[1]>=-1 && e[1]<1 ) ++passed;
+        }
+        profile.print();
+        if( profile.events()!=1000 || profile.treeVisits(0)!=1000 || profile.treeVisits(1)!=unsigned(passed)
+            || profile.rejection(0) != (1000-passed)/1000. || profile.depth(0)<1 ) {
+            throw std::runtime_error("profile counts are wrong");
+        }
+        std::cout << "Profile OK!" << std::endl;
+    }
+
+    /// arrange for mostly large x, then check evaluation, and that the file keeps the layout
+    void testLayout()
+    {
+        // a separate copy: addTree would share the nodes, and so the layout
+        std::ifstream treefile("temptree.txt");
+        DecisionTree dtree(treefile);
+        std::vector<float> rows;
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(2.0, 0.5), normal(0,1.0));
+            rows.insert(rows.end(), e.begin(), e.end());
+        }
+        std::vector<double> before(1000), after(1000);
+        dtree.evaluate(&rows[0], 1000, 2, &before[0]);
+        dtree.optimizeLayout(&rows[0], 1000, 2);
+        dtree.evaluate(&rows[0], 1000, 2, &after[0]);
+        if( after!=before ) throw std::runtime_error("layout: evaluation changed");
+
+        // the root goes right for most: its right child is first in the pair, next to it
+        const CompiledTree& model = dtree.compiled();
+        if( model.root(0)[model.root(0)[0].child+1].child != 3 ) throw std::runtime_error("layout: right child not hot");
+        {
+            std::ofstream out("temptree_layout.txt");
+            dtree.print(out);
+        }
+        std::ifstream in("temptree_layout.txt");
+        DecisionTree reread(in);
+        const CompiledTree& remodel = reread.compiled();
+        if( remodel.size()!=model.size() ) throw std::runtime_error("layout: read back wrong size");
+        for( size_t k=0; k<model.size(); ++k){
+            const CompiledTree::Node &a = model.root(0)[k], &b = remodel.root(0)[k];
+            if( a.index!=b.index || a.child!=b.child ) throw std::runtime_error("layout: not restored from file");
+        }
+        std::cout << "Layout OK!" << std::endl;
+    }
+
+    /// two models, with the variables in opposite order, from one row
+    void testModelSet(const DecisionTree& dtree)
+    {
+        std::vector<std::string> reversed(m_names.rbegin(), m_names.rend());
+        ModelSet set;
+        set.add(dtree, m_names);
+        set.add(dtree, reversed);
+        if( set.variables()!=m_names ) throw std::runtime_error("ModelSet: wrong variables");
+
+        std::vector<float> rows;
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            rows.insert(rows.end(), e.begin(), e.end());
+        }
+        std::vector<double> scores(2*1000), one(2);
+        set.evaluate(&rows[0], 1000, 2, &scores[0]);
+        for( int i=0; i<1000; ++i){
+            set.evaluate(&rows[2*i], &one[0]);
+            double x=rows[2*i], y=rows[2*i+1];
+            if( scores[i]!=dtree(event(x,y)) || scores[1000+i]!=dtree(event(y,x))
+                || one[0]!=scores[i] || one[1]!=scores[1000+i] ) {
+                throw std::runtime_error("ModelSet evaluation did not match");
+            }
+        }
+        std::cout << "ModelSet OK!" << std::endl;
+    }
+
+    /// text to binary and back: the same nodes, the same text, the same values
+    void testModelFile(const DecisionTree& dtree)
+    {
+        ModelFile::write("temptree.bin", dtree, m_names);
+        if( !ModelFile::isModelFile("temptree.bin") ) throw std::runtime_error("ModelFile: not recognized");
+        ModelFile file("temptree.bin");
+        const CompiledTree &a = dtree.compiled(), &b = file.model();
+        if( file.title()!=dtree.title() || file.variables()!=m_names
+            || a.size()!=b.size() || a.treeCount()!=b.treeCount() ) {
+            throw std::runtime_error("ModelFile: header did not match");
+        }
+        for( size_t k=0; k<a.size(); ++k){
+            const CompiledTree::Node &x = a.nodes()[k], &y = b.nodes()[k];
+            if( x.value!=y.value || x.index!=y.index || x.child!=y.child ) throw std::runtime_error("ModelFile: nodes did not match");
+        }
+        std::stringstream text, back;
+        text.precision(17);
+        dtree.print(text);
+        file.print(back);
+        if( text.str()!=back.str() ) throw std::runtime_error("ModelFile: text did not match");
+        CompiledTree reread;
+        TreeReader reader(back);
+        reader.read(reread);
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            if( b(e)!=dtree(e) || reread(e)!=dtree(e) ) throw std::runtime_error("ModelFile: evaluation did not match");
+        }
+
+        // a damaged file is rejected
+        {
+            std::fstream damage("temptree.bin", std::ios::in | std::ios::out | std::ios::binary);
+            damage.seekp(-1, std::ios::end);
+            damage.put('x');
+        }
+        bool rejected=false;
+        try { ModelFile bad("temptree.bin"); }catch(const std::runtime_error&){ rejected=true; }
+        if( !rejected ) throw std::runtime_error("ModelFile: checksum not checked");
+
+        // as read without the checksum: a child position that would wrap, or lead back to the root
+        CompiledTree::Node damaged[] = { {0.5, 0, 1}, {0.1, -1, 0}, {0.9, -1, 0} };
+        std::vector<CompiledTree::Tree> trees(1);
+        trees[0].weight = 1; trees[0].offset = 0;
+        unsigned int children[] = {0xffffffffu, 0};
+        for( int k=0; k<2; ++k){
+            damaged[0].child = children[k];
+            CompiledTree view;
+            rejected = false;
+            try { view.view(damaged, 3, trees); }catch(const std::invalid_argument&){ rejected=true; }
+            if( !rejected ) throw std::runtime_error("ModelFile: bad child position not checked");
+        }
+        std::cout << "ModelFile OK!" << std::endl;
+    }
+
+    /// open the index of temptree_index.txt many times, setting ok if it was always whole
+    class TreeIndexReader {
+    public:
+        TreeIndexReader(int& ok):m_ok(ok){}
+        void operator()()const
+        {
+            m_ok = 1;
+            for( int k=0; k<50; ++k){
+                TreeIndex index("temptree_index.txt");
+                if( index.treeCount()!=4 || index.weight(3)!=5 ) m_ok = 0;
+            }
+        }
+    private:
+        int& m_ok;
+    };
+
+    /// the text reader: the same nodes as compile, and errors with the line number
+    void testReader(const DecisionTree& dtree)
+    {
+        std::stringstream text;
+        dtree.print(text);
+        TreeReader reader(text);
+        CompiledTree model;
+        reader.read(model, 2);
+        const CompiledTree& a = dtree.compiled();
+        if( reader.title()!=dtree.title() || model.size()!=a.size() || model.treeCount()!=a.treeCount() ) {
+            throw std::runtime_error("TreeReader: wrong size");
+        }
+        for( size_t k=0; k<a.size(); ++k){
+            const CompiledTree::Node &x = a.nodes()[k], &y = model.nodes()[k];
+            if( x.value!=y.value || x.index!=y.index || x.child!=y.child ) throw std::runtime_error("TreeReader: nodes did not match");
+        }
+
+        // a branch with only one child
+        std::stringstream bad("bad\n\t0\t-10\t1\n\t1\t0\t0.5\n\t2\t-1\t0.25\n");
+        std::string message;
+        try { TreeReader(bad).read(model); }catch(const std::runtime_error& e){ message = e.what(); }
+        if( message.find("line 3")==std::string::npos ) throw std::runtime_error("TreeReader: error not reported: "+message);
+
+        // filter, tree, filter, tree: read some of them from the index
+        DecisionTree twice(dtree.title());
+        twice.addTree(&dtree);
+        twice.addTree(&dtree);
+        {
+            std::ofstream out("temptree_index.txt");
+            twice.print(out);
+        }
+        std::remove(TreeIndex::indexName("temptree_index.txt").c_str());
+        TreeIndex first("temptree_index.txt");
+        TreeIndex index("temptree_index.txt"); // from the index file this time
+        if( index.treeCount()!=4 || index.select(1).size()!=3 || index.filters().size()!=2
+            || index.title()!=dtree.title() ) {
+            throw std::runtime_error("TreeIndex: wrong trees");
+        }
+        DecisionTree partial(index, index.select(1));
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            if( partial(e)!=twice(e, 1) ) throw std::runtime_error("TreeIndex: evaluation did not match");
+        }
+        if( partial.compiled().treeCount()!=3 ) throw std::runtime_error("TreeIndex: wrong number read");
+
+        // rewritten with the same size, but another weight for the last tree: the index is made again
+        {
+            std::stringstream text;
+            twice.print(text);
+            std::string changed = text.str();
+            size_t last = changed.rfind("0\t-10\t1\n");
+            changed[last+6] = '5';
+            std::ofstream out("temptree_index.txt");
+            out << changed;
+        }
+        TreeIndex again("temptree_index.txt");
+        if( again.weight(3)!=5 ) throw std::runtime_error("TreeIndex: out of date index used");
+
+        // an index cut short, as seen while being written in place, is made again
+        std::string idx = TreeIndex::indexName("temptree_index.txt");
+        std::string saved;
+        {
+            std::ifstream in(idx.c_str());
+            std::getline(in, saved, '\0');
+        }
+        {
+            std::ofstream out(idx.c_str());
+            out << saved.substr(0, saved.size()-1);
+        }
+        TreeIndex whole_again("temptree_index.txt");
+        std::string remade;
+        {
+            std::ifstream in(idx.c_str());
+            std::getline(in, remade, '\0');
+        }
+        if( remade!=saved ) throw std::runtime_error("TreeIndex: index cut short was used");
+
+        // made by several threads at once, while others read it: every one sees a whole index
+        std::remove(TreeIndex::indexName("temptree_index.txt").c_str());
+        std::vector<std::thread> threads;
+        std::vector<int> whole(8, 0);
+        for( int t=0; t<8; ++t){
+            threads.push_back(std::thread(TreeIndexReader(whole[t])));
+        }
+        for( int t=0; t<8; ++t) threads[t].join();
+        if( std::count(whole.begin(), whole.end(), 1)!=8 ) throw std::runtime_error("TreeIndex: part of an index read");
+        std::cout << "TreeReader OK!" << std::endl;
+    }
+
+    /// replace the model while another thread evaluates: it sees one or the other, never a mix
+    void testHandle(const DecisionTree& dtree)
+    {
+        {
+            std::ofstream out("temptree_handle.txt");
+            dtree.print(out);
+        }
+        ModelHandle handle("temptree_handle.txt");
+        std::vector<std::vector<float> > events;
+        std::vector<double> expect;
+        for( int i=0; i<100; ++i){
+            events.push_back(event(normal(0, 1.0), normal(0,1.0)));
+            expect.push_back(dtree(events.back()));
+            if( handle(events.back())!=expect.back() ) throw std::runtime_error("ModelHandle: evaluation did not match");
+        }
+        class Reader {
+        public:
+            Reader(const ModelHandle& handle, const std::vector<std::vector<float> >& events,
+                const std::vector<double>& expect, std::atomic<bool>& done, int& wrong)
+                : m_handle(handle), m_events(events), m_expect(expect), m_done(done), m_wrong(wrong){}
+            void operator()()const
+            {
+                while( !m_done ){
+                    for( size_t i=0; i<m_events.size(); ++i){
+                        double v = m_handle(m_events[i]);
+                        if( v!=m_expect[i] && v!=0.25 ) ++m_wrong;
+                    }
+                }
+            }
+        private:
+            const ModelHandle& m_handle;
+            const std::vector<std::vector<float> >& m_events;
+            const std::vector<double>& m_expect;
+            std::atomic<bool>& m_done;
+            int& m_wrong;
+        };
+        std::atomic<bool> done(false);
+        int wrong=0;
+        std::thread reader(Reader(handle, events, expect, done, wrong));
+        for( int k=0; k<20; ++k){
+            DecisionTree* constant = new DecisionTree(dtree.title());
+            constant->addNode(0, -10, 1.0);
+            constant->addNode(1, -1, 0.25);
+            handle.publish(constant);
+            handle.reload();
+        }
+        done = true;
+        reader.join();
+        if( wrong!=0 || handle.generation()!=41 ) throw std::runtime_error("ModelHandle: wrong model seen");
+        std::cout << "ModelHandle OK!" << std::endl;
+    }
+
+    /// a tree with a test decided by the filter on y, then two equal leaves: fewer nodes, the same values
+    void testSimplify(const DecisionTree& dtree)
+    {
+        DecisionTree extra(dtree.title());
+        extra.addTree(&dtree);
+        extra.addNode(0, -10, 0.5);
+        extra.addNode(1, 1, 2.0);   // y < 2: always, after the filter
+        extra.addNode(2, 0, 0.0);
+        extra.addNode(3, -1, 0.9);
+        extra.addNode(4, -1, 0.2);  // both the same
+        extra.addNode(5, -1, 0.2);
+        TreeSimplifier simplifier(extra.compiled());
+        simplifier.print();
+        const CompiledTree& model = simplifier.model();
+        if( simplifier.decided()!=1 || simplifier.collapsed()!=1
+            || model.size()!=dtree.compiled().size()+1 ) {
+            throw std::runtime_error("TreeSimplifier: nodes not removed");
+        }
+        for( int i=0; i<10000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0, 1.5));
+            if( i%100==0 ) e[i%200==0? 0 : 1] = std::numeric_limits<float>::quiet_NaN();
+            if( model(e)!=extra(e) ) throw std::runtime_error("TreeSimplifier: evaluation did not match");
+        }
+
+        // the tree twice: merged into one, with the same values up to rounding
+        DecisionTree twice(dtree.title());
+        twice.addTree(&dtree);
+        twice.addTree(&dtree);
+        twice.simplify(true);
+        if( twice.compiled().treeCount()!=2 ) throw std::runtime_error("TreeSimplifier: trees not merged");
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0, 1.5));
+            if( fabs(twice(e)-dtree(e)) > 1e-12 ) throw std::runtime_error("TreeSimplifier: merged evaluation did not match");
+        }
+        // merged with weights too small to change the sum: the leaves are scaled once only
+        DecisionTree tiny("tiny");
+        double weights[] = {2.0, 1e-16, 1e-16};
+        for( int t=0; t<3; ++t){
+            tiny.addNode(0, -10, weights[t]);
+            tiny.addNode(1, 0, 0.5);
+            tiny.addNode(2, -1, 0.25);
+            tiny.addNode(3, -1, 0.75);
+        }
+        tiny.simplify(true);
+        if( tiny.compiled().treeCount()!=1 || tiny(event(0.0))!=0.25 || tiny(event(1.0))!=0.75 ) {
+            throw std::runtime_error("TreeSimplifier: merging with small weights");
+        }
+        std::cout << "Simplify OK!" << std::endl;
+    }
+
+    /// the statistics kept from training: importance, attributions, and the file
+    void testExplain(const Classifier& classifier, const DecisionTree& dtree)
+    {
+        TreeExplainer explainer(dtree);
+        std::vector<double> ratings, importance;
+        classifier.rateVariables(ratings);
+        explainer.importance(importance);
+        for( size_t j=0; j<importance.size(); ++j){
+            if( fabs(importance[j]-ratings[j]) > 1e-12*fabs(ratings[j]) ) throw std::runtime_error("TreeExplainer: importance did not match");
+        }
+
+        // the attributions add up to the value
+        std::vector<float> rows;
+        for( int i=0; i<100; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0,1.0));
+            rows.insert(rows.end(), e.begin(), e.end());
+        }
+        int width = explainer.width();
+        std::vector<double> phi(100*(width+1));
+        explainer.explain(&rows[0], 100, 2, &phi[0], 2);
+        for( int i=0; i<100; ++i){
+            double sum = phi[i*(width+1)+width];
+            for( int j=0; j<width; ++j) sum += phi[i*(width+1)+j];
+            if( fabs(sum - dtree(&rows[2*i], 2)) > 1e-12 ) throw std::runtime_error("TreeExplainer: attributions do not add up");
+        }
+
+        // behind a filter on y < 1: a rejected event has the value 0, and so do its attributions
+        DecisionTree filtered(dtree.title());
+        filtered.addNode(0, -10, 0);
+        filtered.addNode(1, 1, 1.0);
+        filtered.addNode(2, -1, 1);
+        filtered.addNode(3, -1, 0);
+        filtered.addTree(&dtree);
+        TreeExplainer behind(filtered);
+        std::vector<float> passed = event(0.5, 0.0), rejected = event(0.5, 2.0);
+        std::vector<double> phi_passed(behind.width()), phi_rejected(behind.width());
+        double sum_passed = behind.explain(&passed[0], &phi_passed[0]),
+            sum_rejected = behind.explain(&rejected[0], &phi_rejected[0]);
+        for( int j=0; j<behind.width(); ++j){ sum_passed += phi_passed[j]; sum_rejected += phi_rejected[j]; }
+        if( filtered(rejected)!=0 || sum_rejected!=0 || fabs(sum_passed - filtered(passed)) > 1e-12 ) {
+            throw std::runtime_error("TreeExplainer: filtered attributions do not add up");
+        }
+
+        // and back from the file
+        std::stringstream text;
+        dtree.print(text, true);
+        TreeReader reader(text);
+        CompiledTree model;
+        reader.read(model);
+        if( !model.hasStatistics() || model.statistics(0)[0].cover <= 0 ) throw std::runtime_error("TreeExplainer: statistics not read");
+        std::cout << "Explain OK!" << std::endl;
+    }
+
+    void testScreen()
+    {
+        std::cout << "\nTesting variable screening...\n";
+        VariableScreen screen(m_data, 2);
+        if( screen.rating(0) <= screen.rating(1) ) throw std::runtime_error("screen: x should be better than y");
+
+        // keep only one: should be x
+        std::vector<int> best = screen.select(1);
+        screen.print();
+        if( best.size()!=1 || best[0]!=0 ) throw std::runtime_error("screen: did not select x");
+
+        // force y as well
+        std::vector<std::string> forced(1, "y");
+        if( screen.select(1, forced).size()!=2 ) throw std::runtime_error("screen: forced variable not kept");
+        std::cout << "Screen OK!" << std::endl;
+    }
+
+    /// three classes: background, and signal split at x=1. One traversal gives all the purities
+    void testClasses()
+    {
+        Classifier::Table data(m_data);
+        for( Classifier::Table::iterator it=data.begin(); it!=data.end(); ++it){
+            if( it->signal() && (*it)[0] > 1 ) it->setCategory(2);
+        }
+        Classifier::Record::setClasses(3);
+        Classifier classifier(data);
+        classifier.makeTree();
+        DecisionTree& dtree = *classifier.createTree("classes");
+        Classifier::Record::setClasses(0);
+        if( dtree.outputs()!=3 ) throw std::runtime_error("classes: expected three outputs");
+
+        std::stringstream text;
+        dtree.print(text);
+        TreeReader reader(text);
+        CompiledTree model;
+        reader.read(model);
+        ModelFile::write("temptree.bin", dtree, m_names);
+        ModelFile file("temptree.bin");
+
+        std::vector<double> outputs, again(3), mapped(3);
+        for( int i=0; i<1000; ++i){
+            std::vector<float> e = event(normal(0, 1.0), normal(0, 1.0));
+            dtree.evaluateAll(e, outputs);
+            double sum = outputs[0]+outputs[1]+outputs[2];
+            if( fabs(sum-1) > 1e-12 ) throw std::runtime_error("classes: purities do not add up to 1");
+            if( fabs(outputs[1]+outputs[2] - dtree(e)) > 1e-12 ) throw std::runtime_error("classes: signal purity did not match");
+            model.evaluateAll(&e[0], &again[0]);
+            file.model().evaluateAll(&e[0], &mapped[0]);
+            for( int k=0; k<3; ++k){
+                if( fabs(again[k]-outputs[k]) > 1e-6 || mapped[k]!=outputs[k] ) throw std::runtime_error("classes: outputs not the same from the files");
+            }
+        }
+        // the split between the signal classes was found
+        dtree.evaluateAll(event(2.0), outputs);
+        if( outputs[2] <= outputs[1] ) throw std::runtime_error("classes: signal classes not separated");
+        dtree.evaluateAll(event(0.5), outputs);
+        if( outputs[1] <= outputs[2] ) throw std::runtime_error("classes: signal classes not separated");
+        delete &dtree;
+        std::remove("temptree.bin");
+        std::cout << "Classes OK!" << std::endl;
+    }
+
+#ifdef CLASSIFIER_TEST_ROOT
+    /// a small tree of three types, read by rows and by blocks
+    void testRoot()
+    {
+        std::cout << "\nTesting reading a ROOT tree...\n";
+        const int entries = 25000;
+        {
+            TFile out("temptuple.root", "RECREATE");
+            TTree* tree = new TTree("tuple", "test");
+            float w; double x; int n;
+            tree->Branch("w", &w, "w/F");
+            tree->Branch("x", &x, "x/D");
+            tree->Branch("n", &n, "n/I");
+            for( int i=0; i<entries; ++i){
+                w = 0.25f*i; x = normal(0); n = i%7-3;
+                tree->Fill();
+            }
+            tree->Write();
+            out.Close(); // deletes the tree
+        }
+        RootTuple tuple("temptuple.root", "tuple");
+        tuple.selectColumns("w,x,n");
+        if( tuple.size()!=static_cast<size_t>(entries) ) throw std::runtime_error("RootTuple: wrong number of rows");
+
+        // blocks that start and end inside baskets, and one past the end
+        std::vector<std::vector<float> > columns;
+        std::vector<float> row;
+        size_t starts[] = {0, 1, 4095, 12345, entries-100};
+        for( size_t s=0; s<sizeof(starts)/sizeof(starts[0]); ++s){
+            size_t n = tuple.fill_block(starts[s], 5000, columns);
+            if( n!=std::min<size_t>(5000, entries-starts[s]) || columns.size()!=3 ) throw std::runtime_error("RootTuple: wrong block size");
+            for( size_t i=0; i<n; ++i){
+                tuple.fill_row(starts[s]+i, row);
+                for( size_t j=0; j<3; ++j){
+                    if( columns[j][i]!=row[j] ) throw std::runtime_error("RootTuple: block and row differ");
+                }
+            }
+        }
+
+        // a leaf named twice gives two columns, by rows and by blocks
+        tuple.selectColumns("w,x,w");
+        tuple.fill_block(12345, 3000, columns);
+        for( size_t i=0; i<3000; ++i){
+            tuple.fill_row(12345+i, row);
+            if( row.size()!=3 || row[2]!=row[0] || columns[0][i]!=row[0] || columns[2][i]!=row[0] || columns[1][i]!=row[1] ) {
+                throw std::runtime_error("RootTuple: leaf named twice");
+            }
+        }
+
+        // read ahead, without the cache and with it: the same blocks, and fewer reads of the file
+        long long cache_size = RootTuple::s_cache_size, sizes[] = {0, cache_size};
+        int reads[2];
+        tuple.selectColumns("w,x,n");
+        for( int k=0; k<2; ++k){
+            RootTuple::s_cache_size = sizes[k];
+            TFile in("temptuple.root");
+            RootTuple cached(static_cast<TTree*>(in.Get("tuple")));
+            cached.selectColumns("w,x,n");
+            RootPrefetch blocks(cached, 0, cached.size());
+            size_t rows = 0;
+            while( const RootPrefetch::Block* block = blocks.next() ){
+                tuple.fill_block(block->first, block->count, columns);
+                if( block->first!=rows || block->columns!=columns ) throw std::runtime_error("RootPrefetch: block differs");
+                rows += block->count;
+            }
+            if( rows!=tuple.size() ) throw std::runtime_error("RootPrefetch: wrong number of rows");
+            reads[k] = in.GetReadCalls();
+        }
+        RootTuple::s_cache_size = cache_size;
+        std::cout << "reads of the file: " << reads[0] << " without a cache, " << reads[1] << " with" << std::endl;
+        if( reads[1] >= reads[0] ) throw std::runtime_error("RootTuple: the cache was not used");
+        std::remove("temptuple.root");
+
+        // files read by one thread, in turn, and several at once, read ahead
+        Classifier::StringList files, none, names;
+        for( int f=0; f<3; ++f){
+            std::stringstream name;
+            name << "temploader" << f;
+            files.push_back(name.str());
+            TFile out((name.str()+".root").c_str(), "RECREATE");
+            TTree* tree = new TTree("TopTree", "test");
+            float w, x;
+            tree->Branch("w", &w, "w/F");
+            tree->Branch("x", &x, "x/F");
+            for( int i=0; i<3000+2000*f; ++i){
+                w = 1+i%3; x = normal(f);
+                tree->Fill();
+            }
+            tree->Write();
+            out.Close();
+        }
+        names.push_back("w");
+        names.push_back("x");
+        RootLoader loader(files, none, names);
+        Classifier::Table tables[2];
+        unsigned int threads[] = {1, 4};
+        std::stringstream log;
+        for( int k=0; k<2; ++k){
+            RootLoader::s_threads = threads[k];
+            loader(tables[k], RootLoader::ALL, log);
+        }
+        RootLoader::s_threads = 0;
+        if( tables[0].size()!=15000 || tables[1].size()!=tables[0].size() ) throw std::runtime_error("RootLoader: wrong number of records");
+        for( size_t i=0; i<tables[0].size(); ++i){
+            const Classifier::Record &a = tables[0][i], &b = tables[1][i];
+            if( a[0]!=b[0] || a.weight()!=b.weight() || !a.signal() ) throw std::runtime_error("RootLoader: records depend on the threads");
+        }
+        for( size_t f=0; f<files.size(); ++f) std::remove((files[f]+".root").c_str());
+        Classifier::Record::setup(m_names, false); // as it was before the loader
+        std::cout << "ROOT OK!" << std::endl;
     }
+#endif
 
     /// return an event
     std::vector<float> event(double x, double y=0){